@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bench {
+
+// Number of C++ heap allocations so far, counted by the operator new defined in allocations.cpp. Allocations made by
+// libdbus itself (malloc) are not included.
+std::size_t allocations();
+
+struct Result {
+    double nsPerOp;
+    double allocationsPerOp;
+};
+
+// Runs fn iterations times and returns the average time per call in nanoseconds.
+template <typename FN> double nsPerOp(std::size_t iterations, FN &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        fn();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(iterations);
+}
+
+template <typename FN> Result measure(std::size_t iterations, FN &&fn) {
+    auto before = allocations();
+    auto ns = nsPerOp(iterations, fn);
+    return {ns, static_cast<double>(allocations() - before) / static_cast<double>(iterations)};
+}
+
+struct Latency {
+    Result average;
+    double p50;
+    double p99;
+};
+
+// Like measure(), but times every call on its own to get the latency distribution.
+template <typename FN> Latency measureLatency(std::size_t iterations, FN &&fn) {
+    std::vector<double> samples(iterations);
+    auto before = allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (auto &sample : samples) {
+        auto callStart = std::chrono::steady_clock::now();
+        fn();
+        sample = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - callStart).count();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    auto allocated = allocations() - before;
+    auto percentile = [&samples](double fraction) {
+        auto nth = samples.begin() + static_cast<std::ptrdiff_t>(fraction * static_cast<double>(samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        return *nth;
+    };
+    return {{elapsed.count() / static_cast<double>(iterations),
+             static_cast<double>(allocated) / static_cast<double>(iterations)},
+            percentile(0.50),
+            percentile(0.99)};
+}
+
+inline void report(std::string_view name, double nsPerOp) {
+    std::cout << std::left << std::setw(40) << name << std::right << std::setw(12) << std::fixed
+              << std::setprecision(1) << nsPerOp << " ns/op" << std::setw(14) << std::setprecision(0)
+              << 1e9 / nsPerOp << " ops/s" << std::endl;
+}
+
+inline void report(std::string_view name, const Result &result) {
+    std::cout << std::left << std::setw(40) << name << std::right << std::setw(12) << std::fixed
+              << std::setprecision(1) << result.nsPerOp << " ns/op" << std::setw(14) << std::setprecision(0)
+              << 1e9 / result.nsPerOp << " ops/s" << std::setw(10) << std::setprecision(1)
+              << result.allocationsPerOp << " allocs/op" << std::endl;
+}
+
+inline void report(std::string_view name, const Latency &latency) {
+    report(name, latency.average);
+    std::cout << std::left << std::setw(40) << "" << std::right << std::setw(12) << std::fixed
+              << std::setprecision(1) << latency.p50 / 1000 << " us p50" << std::setw(12) << latency.p99 / 1000
+              << " us p99" << std::endl;
+}
+
+// A private session bus for the duration of the benchmark, set DBUS_DAEMON to use a dbus-daemon that is not on the
+// PATH.
+class Daemon {
+  public:
+    Daemon() {
+        const char *binary = std::getenv("DBUS_DAEMON");
+        std::string command = std::string{binary ? binary : "dbus-daemon"} +
+                              " --session --fork --print-address=1 --print-pid=1";
+        FILE *output = popen(command.c_str(), "r");
+        if (output == nullptr) {
+            throw std::runtime_error("Could not start " + command);
+        }
+        std::array<char, 512> address{};
+        std::array<char, 32> pidLine{};
+        bool started = fgets(address.data(), address.size(), output) && fgets(pidLine.data(), pidLine.size(), output);
+        pclose(output);
+        if (!started) {
+            throw std::runtime_error("Could not start " + command);
+        }
+        pid = std::atoi(pidLine.data());
+        std::string_view trimmed{address.data()};
+        setenv("DBUS_SESSION_BUS_ADDRESS", std::string{trimmed.substr(0, trimmed.find('\n'))}.c_str(), 1);
+    }
+    Daemon(const Daemon &) = delete;
+    Daemon &operator=(const Daemon &) = delete;
+    ~Daemon() {
+        if (pid > 0) {
+            kill(pid, SIGTERM);
+        }
+    }
+
+  private:
+    pid_t pid{0};
+};
+
+} // namespace bench
@@ -0,0 +1,65 @@
+#include "bench.hpp"
+#include "wibens/dbuspp/eventloop.hpp"
+#include "wibens/dbuspp/server.hpp"
+#include "wibens/dbuspp/sharedblob.hpp"
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+
+using namespace wibens::dbuspp;
+
+namespace {
+constexpr std::string_view SERVICE = "org.example.Blob";
+constexpr std::string_view PATH = "/org/example/Blob";
+constexpr std::string_view INTERFACE = "org.example.Blob";
+constexpr std::size_t MIB = 1 << 20;
+
+type::U64 checksum(const uint8_t *begin, const uint8_t *end) { return std::accumulate(begin, end, type::U64{0}); }
+} // namespace
+
+int main() noexcept(false) {
+    std::unique_ptr<bench::Daemon> daemon;
+    try {
+        daemon = std::make_unique<bench::Daemon>();
+    } catch (const std::exception &e) {
+        std::cout << e.what() << ", skipping" << std::endl;
+        return 0;
+    }
+
+    auto service = DBus::openPrivate(DBUS_BUS_SESSION);
+    service.requestName(SERVICE);
+    ObjectServer server{service};
+    ObjectServer::Interface blob{std::string{INTERFACE}};
+    blob.method("Sum", [](type::ArrayView<type::U8> bytes) { return checksum(bytes.begin(), bytes.end()); })
+        .method("SumBlob", [](const type::SharedBlob &bytes) { return checksum(bytes.begin(), bytes.end()); });
+    server.add(std::string{PATH}, {blob});
+    EventLoop loop;
+    loop.attach(service);
+    std::thread serviceThread{[&loop] { loop.run(); }};
+
+    auto client = DBus::openPrivate(DBUS_BUS_SESSION);
+    for (std::size_t size : {1 * MIB, 4 * MIB, 16 * MIB}) {
+        const type::Array<type::U8> bytes(size, 0x5a);
+        std::size_t iterations = 64 * MIB / size;
+        auto label = [size](std::string_view name) {
+            return std::string{name} + " " + std::to_string(size / MIB) + " MiB";
+        };
+
+        bench::report(label("ay: Sum"), bench::measureLatency(iterations, [&] {
+                          client.call<type::U64>(SERVICE, PATH, INTERFACE, "Sum", bytes);
+                      }));
+        // Includes copying the data into a new memfd for every call.
+        bench::report(label("h: SumBlob copy"), bench::measureLatency(iterations, [&] {
+                          client.call<type::U64>(SERVICE, PATH, INTERFACE, "SumBlob",
+                                                 type::SharedBlob{bytes.data(), bytes.size()});
+                      }));
+        const type::SharedBlob shared{bytes.data(), bytes.size()};
+        bench::report(label("h: SumBlob reused"), bench::measureLatency(iterations, [&] {
+                          client.call<type::U64>(SERVICE, PATH, INTERFACE, "SumBlob", shared);
+                      }));
+    }
+
+    loop.stop();
+    serviceThread.join();
+}
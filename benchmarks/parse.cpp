@@ -0,0 +1,103 @@
+#include "bench.hpp"
+#include "wibens/dbuspp/dbuspp.hpp"
+#include "wibens/dbuspp/wire.hpp"
+#include <string>
+
+using namespace wibens::dbuspp;
+
+namespace {
+using PropertyValue = type::Variant<type::I32, type::String>;
+using ManagedProperties = type::Dict<type::String, type::Dict<type::String, PropertyValue>>;
+using Pairs = type::Array<type::Struct<type::I32, type::I32>>;
+
+constexpr std::size_t ITERATIONS = 2000;
+constexpr std::size_t INTERFACES = 20;
+constexpr std::size_t PROPERTIES = 10;
+constexpr std::size_t BYTES = 1 << 20;
+constexpr std::size_t PATHS = 1000;
+constexpr std::size_t PAIRS = 10000;
+
+ManagedProperties makeProperties() {
+    ManagedProperties interfaces;
+    for (std::size_t i = 0; i < INTERFACES; ++i) {
+        auto &properties = interfaces["org.example.Interface" + std::to_string(i)];
+        for (std::size_t j = 0; j < PROPERTIES; ++j) {
+            if (j % 2 == 0) {
+                properties.emplace("Number" + std::to_string(j), static_cast<type::I32>(j));
+            } else {
+                properties.emplace("Text" + std::to_string(j), "value " + std::to_string(j));
+            }
+        }
+    }
+    return interfaces;
+}
+
+type::Array<type::ObjectPath> makePaths() {
+    type::Array<type::ObjectPath> paths;
+    for (std::size_t i = 0; i < PATHS; ++i) {
+        paths.emplace_back(("/org/example/objects/" + std::to_string(i)).c_str());
+    }
+    return paths;
+}
+
+Pairs makePairs() {
+    Pairs pairs;
+    for (std::size_t i = 0; i < PAIRS; ++i) {
+        pairs.emplace_back(static_cast<type::I32>(i), -static_cast<type::I32>(i));
+    }
+    return pairs;
+}
+
+type::Dict<type::String, PropertyValue> makeFlatProperties() {
+    type::Dict<type::String, PropertyValue> properties;
+    for (const auto &[interface, values] : makeProperties()) {
+        for (const auto &[name, value] : values) {
+            properties.emplace(interface + "." + name, value);
+        }
+    }
+    return properties;
+}
+
+// A message carrying value as its only argument, like a reply received from the bus.
+template <typename T> DBus::Message makeMessage(const T &value) {
+    DBus::Message msg{dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN)};
+    msg.addArgument(value);
+    return msg;
+}
+
+template <typename T, bool CHECKED = true> void parse(const DBus::Message &msg) {
+    DBusMessageIter iter;
+    dbus_message_iter_init(msg.get(), &iter);
+    auto value = parsers::Parser<T>::template parse<CHECKED>(&iter);
+    static_cast<void>(value);
+}
+
+// Parses and marshals a value of type T, views parse the same message as PARSED.
+template <typename T, typename... VIEWS> void run(std::string_view name, const T &value) {
+    auto msg = makeMessage(value);
+    bench::report(std::string{name} + " parse", bench::measure(ITERATIONS, [&] { parse<T>(msg); }));
+    bench::report(std::string{name} + " parse unchecked", bench::measure(ITERATIONS, [&] { parse<T, false>(msg); }));
+    (bench::report(std::string{name} + " view " + std::string{parsers::signatureOf<VIEWS>},
+                   bench::measure(ITERATIONS, [&] { parse<VIEWS, false>(msg); })),
+     ...);
+    bench::report(std::string{name} + " marshal", bench::measure(ITERATIONS, [&] { makeMessage(value); }));
+    if constexpr (wire::usesCodec<T>) {
+        DBus::Message prototype{"org.example.Service", "/org/example", "org.example.Interface", "Method"};
+        bench::report(std::string{name} + " wire decode",
+                      bench::measure(ITERATIONS, [&] { static_cast<void>(wire::decode<T>(msg.get())); }));
+        bench::report(std::string{name} + " wire encode",
+                      bench::measure(ITERATIONS, [&] { wire::encode(prototype, value); }));
+    }
+}
+} // namespace
+
+int main() noexcept(false) {
+    run("a{sa{sv}}", makeProperties());
+    auto properties = makeMessage(makeProperties());
+    // Takes about as long as parse, only the allocations go down.
+    bench::report("a{sa{sv}} ValueTree", bench::measure(ITERATIONS, [&] { type::ValueTree tree{properties.get()}; }));
+    run<type::Array<type::U8>, type::ArrayView<type::U8>>("ay (1 MiB)", type::Array<type::U8>(BYTES, 0x5a));
+    run<type::Array<type::ObjectPath>, type::Array<type::ObjectPathView>>("ao", makePaths());
+    run("a(ii)", makePairs());
+    run("a{sv}", makeFlatProperties());
+}
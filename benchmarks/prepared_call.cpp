@@ -0,0 +1,47 @@
+#include "bench.hpp"
+#include "wibens/dbuspp/dbuspp.hpp"
+#include <iostream>
+#include <memory>
+
+using namespace wibens::dbuspp;
+
+namespace {
+constexpr std::string_view DESTINATION = "org.freedesktop.DBus";
+constexpr std::string_view PATH = "/org/freedesktop/DBus";
+constexpr std::string_view INTERFACE = "org.freedesktop.DBus";
+constexpr std::string_view METHOD = "GetNameOwner";
+constexpr std::size_t BUILD_ITERATIONS = 1000000;
+constexpr std::size_t CALL_ITERATIONS = 20000;
+} // namespace
+
+int main() noexcept(false) {
+    // Message construction needs no bus, the round trips are measured when one is available.
+    std::unique_ptr<DBus> dbus;
+    try {
+        dbus = std::make_unique<DBus>();
+    } catch (const std::exception &e) {
+        std::cout << "No bus available (" << e.what() << "), only measuring message construction" << std::endl;
+    }
+
+    PreparedCall<type::String(type::String)> getNameOwner{dbus.get(), std::string{DESTINATION}, std::string{PATH},
+                                                          std::string{INTERFACE}, std::string{METHOD}};
+    const type::String name{DESTINATION};
+
+    bench::report("build: DBus::Message", bench::nsPerOp(BUILD_ITERATIONS, [&] {
+                      DBus::Message msg{DESTINATION, PATH, INTERFACE, METHOD, name};
+                  }));
+    bench::report("build: PreparedCall", bench::nsPerOp(BUILD_ITERATIONS, [&] {
+                      auto msg = getNameOwner.makeMessage(name);
+                  }));
+    // Interface and property names are passed as string_views, as Properties::get does.
+    bench::report("build: Properties.Get", bench::measure(BUILD_ITERATIONS, [&] {
+                      DBus::Message msg{DESTINATION, PATH, DBUS_PROPS, "Get", INTERFACE, METHOD};
+                  }));
+
+    if (dbus) {
+        bench::report("call: DBus::call", bench::nsPerOp(CALL_ITERATIONS, [&] {
+                          dbus->call<type::String>(DESTINATION, PATH, INTERFACE, METHOD, name);
+                      }));
+        bench::report("call: PreparedCall", bench::nsPerOp(CALL_ITERATIONS, [&] { getNameOwner(name); }));
+    }
+}
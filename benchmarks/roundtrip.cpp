@@ -0,0 +1,129 @@
+#include "bench.hpp"
+#include "wibens/dbuspp/eventloop.hpp"
+#include "wibens/dbuspp/peer.hpp"
+#include "wibens/dbuspp/server.hpp"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace wibens::dbuspp;
+
+namespace {
+constexpr std::string_view SERVICE = "org.example.Echo";
+constexpr std::string_view PATH = "/org/example/Echo";
+constexpr std::string_view INTERFACE = "org.example.Echo";
+constexpr std::size_t CALL_ITERATIONS = 20000;
+constexpr std::size_t BYTES_ITERATIONS = 2000;
+constexpr std::size_t BYTES = 64 * 1024;
+constexpr std::size_t BATCH = 1000;
+constexpr std::size_t BATCHES = 20;
+constexpr std::size_t OBJECTS = 16;
+constexpr std::size_t PROPERTY_ROUNDS = 200;
+} // namespace
+
+int main() noexcept(false) {
+    std::unique_ptr<bench::Daemon> daemon;
+    try {
+        daemon = std::make_unique<bench::Daemon>();
+    } catch (const std::exception &e) {
+        std::cout << e.what() << ", skipping" << std::endl;
+        return 0;
+    }
+
+    auto service = DBus::openPrivate(DBUS_BUS_SESSION);
+    service.requestName(SERVICE);
+    ObjectServer server{service};
+    ObjectServer::Interface echo{std::string{INTERFACE}};
+    echo.method("Echo", [](std::string_view text) { return text; })
+        .method("EchoBytes", [](type::ArrayView<type::U8> bytes) { return bytes; });
+    server.add(std::string{PATH}, {echo});
+    ObjectServer::Interface device{"org.example.Device"};
+    device.property("Name", [] { return type::String{"eth0"}; })
+        .property("Address", [] { return type::String{"00:11:22:33:44:55"}; })
+        .property("Mtu", [] { return type::U32{1500}; })
+        .property("Up", [] { return true; });
+    for (std::size_t i = 0; i < OBJECTS; ++i) {
+        server.add(std::string{PATH} + "/Device" + std::to_string(i), {device});
+    }
+    EventLoop loop;
+    loop.attach(service);
+    std::thread serviceThread{[&loop] { loop.run(); }};
+
+    auto client = DBus::openPrivate(DBUS_BUS_SESSION);
+    const type::String text = "The quick brown fox jumps over the lazy dog";
+    const type::Array<type::U8> bytes(BYTES, 0x5a);
+    PreparedCall<type::String(type::String)> preparedEcho{&client, std::string{SERVICE}, std::string{PATH},
+                                                          std::string{INTERFACE}, "Echo"};
+
+    bench::report("call: DBus::call Echo(s)", bench::measureLatency(CALL_ITERATIONS, [&] {
+                      client.call<type::String>(SERVICE, PATH, INTERFACE, "Echo", text);
+                  }));
+    bench::report("call: PreparedCall Echo(s)", bench::measureLatency(CALL_ITERATIONS, [&] { preparedEcho(text); }));
+    bench::report("call: EchoBytes(ay) 64 KiB", bench::measureLatency(BYTES_ITERATIONS, [&] {
+                      client.call<type::Array<type::U8>>(SERVICE, PATH, INTERFACE, "EchoBytes", bytes);
+                  }));
+
+    auto pipelined = bench::measure(BATCHES, [&] {
+        std::vector<DBus::PendingCall<type::String>> calls;
+        calls.reserve(BATCH);
+        for (std::size_t i = 0; i < BATCH; ++i) {
+            calls.push_back(preparedEcho.async(text));
+        }
+        client.waitAll(calls);
+        for (auto &call : calls) {
+            call.get();
+        }
+    });
+    bench::report("pipelined: Echo(s) x" + std::to_string(BATCH),
+                  bench::Result{pipelined.nsPerOp / BATCH, pipelined.allocationsPerOp / BATCH});
+
+    // Four properties of each of OBJECTS objects, one Get each versus one GetAll per object sent at once.
+    auto devicePath = [](std::size_t i) { return std::string{PATH} + "/Device" + std::to_string(i); };
+    auto gets = bench::measure(PROPERTY_ROUNDS, [&] {
+        for (std::size_t i = 0; i < OBJECTS; ++i) {
+            Properties properties{&client, std::string{SERVICE}, devicePath(i)};
+            (void)properties.get<type::String>("org.example.Device", "Name");
+            (void)properties.get<type::String>("org.example.Device", "Address");
+            (void)properties.get<type::U32>("org.example.Device", "Mtu");
+            (void)properties.get<bool>("org.example.Device", "Up");
+        }
+    });
+    bench::report("properties: Properties::get x" + std::to_string(4 * OBJECTS), gets);
+    auto batched = bench::measure(PROPERTY_ROUNDS, [&] {
+        PropertyBatch batch{&client, std::string{SERVICE}};
+        std::vector<PropertyBatch::Handle<type::String>> strings;
+        std::vector<PropertyBatch::Handle<type::U32>> mtus;
+        std::vector<PropertyBatch::Handle<bool>> ups;
+        for (std::size_t i = 0; i < OBJECTS; ++i) {
+            strings.push_back(batch.get<type::String>(devicePath(i), "org.example.Device", "Name"));
+            strings.push_back(batch.get<type::String>(devicePath(i), "org.example.Device", "Address"));
+            mtus.push_back(batch.get<type::U32>(devicePath(i), "org.example.Device", "Mtu"));
+            ups.push_back(batch.get<bool>(devicePath(i), "org.example.Device", "Up"));
+        }
+        batch.run();
+        for (std::size_t i = 0; i < OBJECTS; ++i) {
+            (void)strings[2 * i].get();
+            (void)strings[2 * i + 1].get();
+            (void)mtus[i].get();
+            (void)ups[i].get();
+        }
+    });
+    bench::report("properties: PropertyBatch x" + std::to_string(4 * OBJECTS), batched);
+
+    // The same service on a direct connection, without the daemon in between.
+    PeerServer peerServer{loop, "unix:tmpdir=/tmp", [&echo](PeerConnection &connection) {
+                              auto objects = std::make_shared<ObjectServer>(connection);
+                              objects->add(std::string{PATH}, {echo});
+                              return objects;
+                          }};
+    PeerConnection peer{peerServer.address()};
+    PreparedCall<type::String(type::String)> peerEcho{&peer, "", std::string{PATH}, std::string{INTERFACE}, "Echo"};
+    bench::report("peer: PreparedCall Echo(s)", bench::measureLatency(CALL_ITERATIONS, [&] { peerEcho(text); }));
+    bench::report("peer: EchoBytes(ay) 64 KiB", bench::measureLatency(BYTES_ITERATIONS, [&] {
+                      peer.call<type::Array<type::U8>>("", PATH, INTERFACE, "EchoBytes", bytes);
+                  }));
+
+    loop.stop();
+    serviceThread.join();
+}
@@ -0,0 +1,31 @@
+# dbuspp_generate_proxy(<target> <xml> [NAMESPACE <namespace>] [HEADER <header>])
+#
+# Generates typed proxy classes for the interfaces in the introspection file <xml> at build time. The header (by
+# default the name of <xml> with .hpp) is placed in a directory that is added to the include path of <target>.
+find_package(Python3 REQUIRED COMPONENTS Interpreter)
+find_file(DBUSPP_PROXYGEN dbuspp-proxygen.py
+    PATHS ${CMAKE_CURRENT_LIST_DIR} ${CMAKE_CURRENT_LIST_DIR}/../tools
+    NO_DEFAULT_PATH
+)
+
+function(dbuspp_generate_proxy TARGET XML)
+    cmake_parse_arguments(PROXY "" "NAMESPACE;HEADER" "" ${ARGN})
+    get_filename_component(XML_PATH ${XML} ABSOLUTE)
+    if(NOT PROXY_HEADER)
+        get_filename_component(PROXY_HEADER ${XML} NAME)
+        string(REGEX REPLACE "\\.xml$" ".hpp" PROXY_HEADER ${PROXY_HEADER})
+    endif()
+    set(OUTPUT_DIR ${CMAKE_CURRENT_BINARY_DIR}/dbuspp_proxies)
+    set(OUTPUT ${OUTPUT_DIR}/${PROXY_HEADER})
+
+    add_custom_command(
+        OUTPUT ${OUTPUT}
+        COMMAND ${CMAKE_COMMAND} -E make_directory ${OUTPUT_DIR}
+        COMMAND Python3::Interpreter ${DBUSPP_PROXYGEN} --namespace "${PROXY_NAMESPACE}" ${XML_PATH} ${OUTPUT}
+        DEPENDS ${XML_PATH} ${DBUSPP_PROXYGEN}
+        COMMENT "Generating dbuspp proxies ${PROXY_HEADER}"
+        VERBATIM
+    )
+    target_sources(${TARGET} PRIVATE ${OUTPUT})
+    target_include_directories(${TARGET} PRIVATE ${OUTPUT_DIR})
+endfunction()
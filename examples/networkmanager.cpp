@@ -7,27 +7,49 @@ int main() noexcept(false) {
     using namespace type;
     DBus dbus;
 
-    auto networkManager = Properties{&dbus, "org.freedesktop.NetworkManager", "/org/freedesktop/NetworkManager"};
+    static constexpr auto SERVICE = "org.freedesktop.NetworkManager";
+    static constexpr auto DEVICE = "org.freedesktop.NetworkManager.Device";
+    auto networkManager = Properties{&dbus, SERVICE, "/org/freedesktop/NetworkManager"};
     auto devices = networkManager.get<Array<ObjectPath>>("org.freedesktop.NetworkManager", "Devices");
 
+    // All properties of all devices are read with one GetAll per device, sent at once.
+    struct Device {
+        PropertyBatch::Handle<String> interface;
+        PropertyBatch::Handle<String> hwAddress;
+        PropertyBatch::Handle<ObjectPath> ip4Config;
+        PropertyBatch::Handle<ObjectPath> ip6Config;
+    };
+    PropertyBatch batch{&dbus, SERVICE};
+    std::vector<Device> details;
     for (const auto &device : devices) {
-        auto nmDevice = Properties{&dbus, "org.freedesktop.NetworkManager", device};
-        std::cout << "Interface:  " << nmDevice.get<String>("org.freedesktop.NetworkManager.Device", "Interface")
-                  << std::endl;
-        std::cout << "MacAddress: " << nmDevice.get<String>("org.freedesktop.NetworkManager.Device", "HwAddress")
-                  << std::endl;
-        static constexpr auto properies = {std::make_pair("Ip4Config", "org.freedesktop.NetworkManager.IP4Config"),
-                                           std::make_pair("Ip6Config", "org.freedesktop.NetworkManager.IP6Config")};
-        for (const auto [property, interface] : properies) {
-            auto connection = nmDevice.get<ObjectPath>("org.freedesktop.NetworkManager.Device", property);
-            if (connection != "/") {
-                auto peer = Peer{&dbus, "org.freedesktop.NetworkManager", "/org/freedesktop/NetworkManager"};
-                auto v4cfg = Properties{&dbus, "org.freedesktop.NetworkManager", connection};
-                auto v4addr = v4cfg.get<Array<Dict<String, Variant<String, U32>>>>(interface, "AddressData");
-                for (const auto &addr : v4addr) {
-                    std::cout << "Address:    " << std::get<String>(addr.at("address")) << "/"
-                              << std::get<U32>(addr.at("prefix")) << std::endl;
-                }
+        details.push_back({batch.get<String>(device, DEVICE, "Interface"),
+                           batch.get<String>(device, DEVICE, "HwAddress"),
+                           batch.get<ObjectPath>(device, DEVICE, "Ip4Config"),
+                           batch.get<ObjectPath>(device, DEVICE, "Ip6Config")});
+    }
+    batch.run();
+
+    using AddressData = Array<Dict<String, Variant<String, U32>>>;
+    std::vector<std::vector<PropertyBatch::Handle<AddressData>>> addresses(details.size());
+    for (std::size_t i = 0; i < details.size(); ++i) {
+        if (auto config = details[i].ip4Config.get(); config != "/") {
+            addresses[i].push_back(batch.get<AddressData>(config, "org.freedesktop.NetworkManager.IP4Config",
+                                                          "AddressData"));
+        }
+        if (auto config = details[i].ip6Config.get(); config != "/") {
+            addresses[i].push_back(batch.get<AddressData>(config, "org.freedesktop.NetworkManager.IP6Config",
+                                                          "AddressData"));
+        }
+    }
+    batch.run();
+
+    for (std::size_t i = 0; i < details.size(); ++i) {
+        std::cout << "Interface:  " << details[i].interface.get() << std::endl;
+        std::cout << "MacAddress: " << details[i].hwAddress.get() << std::endl;
+        for (const auto &config : addresses[i]) {
+            for (const auto &addr : config.get()) {
+                std::cout << "Address:    " << std::get<String>(addr.at("address")) << "/"
+                          << std::get<U32>(addr.at("prefix")) << std::endl;
             }
         }
         std::cout << std::endl;
@@ -0,0 +1,33 @@
+#include "networkmanager.hpp"
+#include <iostream>
+
+using namespace wibens::dbuspp;
+
+// Same output as networkmanager.cpp, using the proxies generated from networkmanager.xml.
+int main() noexcept(false) {
+    using namespace type;
+    DBus dbus;
+
+    static constexpr auto SERVICE = "org.freedesktop.NetworkManager";
+    nm::NetworkManager networkManager{&dbus, SERVICE, "/org/freedesktop/NetworkManager"};
+
+    for (const auto &path : networkManager.devices()) {
+        nm::NetworkManagerDevice device{&dbus, SERVICE, path};
+        std::cout << "Interface:  " << device.interface() << std::endl;
+        std::cout << "MacAddress: " << device.hwAddress() << std::endl;
+
+        auto print = [](const Array<Dict<String, nm::Variant>> &addresses) {
+            for (const auto &addr : addresses) {
+                std::cout << "Address:    " << std::get<String>(addr.at("address")) << "/"
+                          << std::get<U32>(addr.at("prefix")) << std::endl;
+            }
+        };
+        if (auto config = device.ip4Config(); config != "/") {
+            print(nm::NetworkManagerIP4Config{&dbus, SERVICE, config}.addressData());
+        }
+        if (auto config = device.ip6Config(); config != "/") {
+            print(nm::NetworkManagerIP6Config{&dbus, SERVICE, config}.addressData());
+        }
+        std::cout << std::endl;
+    }
+}
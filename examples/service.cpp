@@ -0,0 +1,36 @@
+#include "wibens/dbuspp/eventloop.hpp"
+#include "wibens/dbuspp/server.hpp"
+#include <iostream>
+
+using namespace wibens::dbuspp;
+
+// Try it with: busctl --user call com.example.Calculator /com/example/Calculator com.example.Calculator Add ii 2 3
+int main() noexcept(false) {
+    using namespace type;
+    DBus dbus{DBUS_BUS_SESSION};
+    if (!dbus.requestName("com.example.Calculator")) {
+        std::cerr << "com.example.Calculator is already taken" << std::endl;
+        return 1;
+    }
+
+    ObjectServer server{dbus};
+    I32 precision = 2;
+    ObjectServer::Interface calculator{"com.example.Calculator"};
+    calculator.method("Add", [](I32 lhs, I32 rhs) { return lhs + rhs; }, {"lhs", "rhs", "sum"})
+        .method(
+            "Divide",
+            [](Double lhs, Double rhs) {
+                if (rhs == 0) {
+                    throw ObjectServer::Error("com.example.Calculator.Error.DivisionByZero", "Division by zero");
+                }
+                return lhs / rhs;
+            },
+            {"lhs", "rhs", "quotient"})
+        .property("Precision", [&precision] { return precision; }, [&precision](I32 value) { precision = value; })
+        .signal<String>("Cleared", {"reason"});
+    server.add("/com/example/Calculator", {calculator});
+
+    EventLoop loop;
+    loop.attach(dbus);
+    loop.run();
+}
@@ -1,105 +1,350 @@
 #pragma once
 
 #include "types.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <dbus-1.0/dbus/dbus.h>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#ifdef DBUSPP_INSTRUMENTATION
+#include "instrumentation.hpp"
+#endif
 
 namespace wibens::dbuspp {
 inline namespace v1 {
 
+inline constexpr const char *DBUS_PROPS = "org.freedesktop.DBus.Properties";
+
 class DBus {
   public:
     using MessageType = std::unique_ptr<DBusMessage, void (*)(DBusMessage *)>;
     class Message {
       public:
+        // An empty bus leaves the destination unset, as used on peer to peer connections.
         Message(std::string_view bus, std::string_view path, std::string_view interface, std::string_view method)
-            : msg({dbus_message_new_method_call(bus.data(), path.data(), interface.data(), method.data()),
+            : msg({dbus_message_new_method_call(bus.empty() ? nullptr : bus.data(), path.data(), interface.data(),
+                                                method.data()),
                    dbus_message_unref}) {
             if (msg == nullptr) {
                 throw std::runtime_error("Could not create dbus message");
             }
         }
 
+        explicit Message(DBusMessage *msgPtr) : msg({msgPtr, dbus_message_unref}) {
+            if (msg == nullptr) {
+                throw std::runtime_error("Could not create dbus message");
+            }
+        }
+
         template <typename... Args>
         Message(std::string_view bus, std::string_view path, std::string_view interface, std::string_view method,
-                Args... args)
+                const Args &...args)
             : Message(bus, path, interface, method) {
             addArguments(args...);
         }
 
-        template <typename T, typename... TYPES> void addArguments(T first, TYPES... args) {
-            addArgument(first);
-            if constexpr (sizeof...(args) > 0) {
-                addArguments(args...);
-            }
+        template <typename... TYPES> void addArguments(const TYPES &...args) {
+            DBusMessageIter iter;
+            dbus_message_iter_init_append(msg.get(), &iter);
+            (parsers::Parser<std::decay_t<const TYPES>>::append(&iter, args), ...);
         }
 
-        template <typename T> inline void addArgument(const T &arg) { parsers::Parser<T>::addArgument(msg.get(), arg); }
+        template <typename T> inline void addArgument(const T &arg) { addArguments(arg); }
 
         [[nodiscard]] inline DBusMessage *get() const { return msg.get(); }
 
       private:
         MessageType msg;
-
-        inline void addArgument(std::string_view arg) {
-            auto temp = arg.data();
-            dbus_message_append_args(msg.get(), DBUS_TYPE_STRING, &temp, DBUS_TYPE_INVALID);
-        }
-        inline void addArgument(uint32_t arg) {
-            dbus_message_append_args(msg.get(), DBUS_TYPE_UINT32, &arg, DBUS_TYPE_INVALID);
-        }
     };
     class Reply {
       public:
         Reply(DBusMessage *replyPtr) : reply({replyPtr, dbus_message_unref}) {
+            if (reply == nullptr) {
+                throw std::runtime_error("No reply received");
+            }
+            if (dbus_message_get_type(reply.get()) == DBUS_MESSAGE_TYPE_ERROR) {
+                DBusError err;
+                dbus_error_init(&err);
+                dbus_set_error_from_message(&err, reply.get());
+                std::string what = std::string{"DBUS Message failed: "} + (err.message ? err.message : err.name);
+                dbus_error_free(&err);
+                throw std::runtime_error(what);
+            }
             if (dbus_message_get_type(reply.get()) != DBUS_MESSAGE_TYPE_METHOD_RETURN) {
                 throw std::runtime_error("Invalid reply type");
             }
         }
 
         template <typename T> auto response() {
+            static_assert(!parsers::containsView<T>, "Views can only be parsed with Reply::view<T>()");
+            return parse<T>();
+        }
+
+        // Like response<T>(), but T may contain views into the reply. The reply must outlive them.
+        template <typename T> auto view() & { return parse<T>(); }
+        template <typename T> auto view() && = delete;
+
+        // All arguments as dynamic values, for replies of which the type is not known up front. The tree is parsed on
+        // the first call and owned by the reply.
+        const type::ValueTree &values() & {
+            if (!tree) {
+                tree = std::make_unique<type::ValueTree>(reply.get());
+            }
+            return *tree;
+        }
+        const type::ValueTree &values() && = delete;
+
+        [[nodiscard]] inline DBusMessage *get() const { return reply.get(); }
+
+      private:
+        // When the reply signature matches the one of T it is validated once and the unchecked parser is used.
+        template <typename T> auto parse() {
             DBusMessageIter iter;
             if (!dbus_message_iter_init(reply.get(), &iter)) {
                 throw std::runtime_error("Could not create dbus message iterator");
             }
-            return parsers::Parser<T>::parse(&iter);
+            std::string_view received = dbus_message_get_signature(reply.get());
+            if constexpr (parsers::Parser<T>::exactSignature) {
+                if (received == parsers::signatureOf<T>) {
+                    return parsers::Parser<T>::template parse<false>(&iter);
+                }
+            }
+            try {
+                return parsers::Parser<T>::parse(&iter);
+            } catch (const parsers::ParseException &e) {
+                throw parsers::ParseException(std::string{e.what()} + " (expected signature " +
+                                              std::string{parsers::signatureOf<T>} + ", received " +
+                                              std::string{received} + ")");
+            }
         }
 
-      private:
         MessageType reply;
+        std::unique_ptr<type::ValueTree> tree;
+    };
+    template <typename T = void> class PendingCall {
+      public:
+        explicit PendingCall(DBusPendingCall *pendingPtr) : pending({pendingPtr, dbus_pending_call_unref}) {}
+
+        [[nodiscard]] bool ready() const { return dbus_pending_call_get_completed(pending.get()) != 0; }
+        void wait() { dbus_pending_call_block(pending.get()); }
+        void cancel() { dbus_pending_call_cancel(pending.get()); }
+
+        T get() {
+            auto result = reply();
+            if constexpr (!std::is_same_v<T, void>) {
+                return result.template response<T>();
+            }
+        }
+
+        // The reply itself, for callers that parse it on their own. Like get(), it can only be taken once.
+        Reply reply() {
+            wait();
+            DBusMessage *replyPtr = dbus_pending_call_steal_reply(pending.get());
+#ifdef DBUSPP_INSTRUMENTATION
+            Instrumentation::finished(pending.get(), replyPtr);
+#endif
+            return Reply{replyPtr};
+        }
+
+        // Invokes callback(PendingCall &) once the reply has arrived, get() will not block from within the callback.
+        // The connection must be dispatched by a main loop for this to happen.
+        template <typename CALLBACK> void then(CALLBACK &&callback) {
+            // The reply may arrive on the loop thread at any point, so the notification is installed before checking
+            // for completion and whichever comes second does nothing.
+            struct Notify {
+                std::function<void(PendingCall &)> callback;
+                std::atomic<bool> called{false};
+            };
+            auto *data = new Notify{std::forward<CALLBACK>(callback)};
+            auto notify = [](DBusPendingCall *pendingPtr, void *userData) {
+#ifdef DBUSPP_INSTRUMENTATION
+                Instrumentation::completed(pendingPtr);
+#endif
+                auto &state = *static_cast<Notify *>(userData);
+                if (!state.called.exchange(true)) {
+                    PendingCall completed{dbus_pending_call_ref(pendingPtr)};
+                    state.callback(completed);
+                }
+            };
+            auto free = [](void *userData) { delete static_cast<Notify *>(userData); };
+            if (!dbus_pending_call_set_notify(pending.get(), notify, data, free)) {
+                delete data;
+                throw std::runtime_error("Could not set pending call notification");
+            }
+            if (ready()) {
+                notify(pending.get(), data);
+            }
+        }
+
+        [[nodiscard]] inline DBusPendingCall *getPending() const { return pending.get(); }
+
+      private:
+        std::unique_ptr<DBusPendingCall, void (*)(DBusPendingCall *)> pending;
+    };
+
+  private:
+    class SignalRouter;
+
+  public:
+    using SignalHandler = std::function<void(DBusMessage *)>;
+
+    // Keeps a signal handler installed, the handler and its match rule are removed on destruction.
+    class Subscription {
+      public:
+        Subscription() = default;
+        Subscription(std::weak_ptr<SignalRouter> router, uint64_t id) : router(std::move(router)), id(id) {}
+        Subscription(const Subscription &) = delete;
+        Subscription(Subscription &&other) noexcept : router(std::move(other.router)), id(other.id) {
+            other.router.reset();
+        }
+        Subscription &operator=(const Subscription &) = delete;
+        Subscription &operator=(Subscription &&other) noexcept {
+            if (this != &other) {
+                unsubscribe();
+                router = std::move(other.router);
+                id = other.id;
+                other.router.reset();
+            }
+            return *this;
+        }
+        ~Subscription() { unsubscribe(); }
+
+        void unsubscribe() {
+            if (auto locked = router.lock()) {
+                locked->remove(id);
+            }
+            router.reset();
+        }
+
+      private:
+        std::weak_ptr<SignalRouter> router;
+        uint64_t id{0};
     };
 
-    DBus() {
+    // Uses the connection to the bus that is shared within the process.
+    explicit DBus(DBusBusType busType = DBUS_BUS_SYSTEM) {
+        dbus_threads_init_default();
         DBusError err;
         dbus_error_init(&err);
 
-        conn = ConnectionType(dbus_bus_get(DBUS_BUS_SYSTEM, &err), dbus_connection_unref);
+        conn = ConnectionType(dbus_bus_get(busType, &err), dbus_connection_unref);
         if (dbus_error_is_set(&err)) {
+            dbus_error_free(&err);
             throw std::runtime_error("Could not connect to dbus");
         }
+        signals = std::make_shared<SignalRouter>(conn.get(), true);
     }
 
+    // Opens a new connection to the bus that is not shared with anyone else.
+    static DBus openPrivate(DBusBusType busType = DBUS_BUS_SYSTEM) {
+        dbus_threads_init_default();
+        DBusError err;
+        dbus_error_init(&err);
+
+        ConnectionType privateConn{dbus_bus_get_private(busType, &err), closeConnection};
+        if (dbus_error_is_set(&err)) {
+            dbus_error_free(&err);
+            throw std::runtime_error("Could not connect to dbus");
+        }
+        dbus_connection_set_exit_on_disconnect(privateConn.get(), FALSE);
+        return DBus{std::move(privateConn)};
+    }
+
+    // Opens a new private connection to the bus at address, e.g. "unix:path=/run/custom_bus_socket".
+    static DBus openAddress(std::string_view address) {
+        dbus_threads_init_default();
+        DBusError err;
+        dbus_error_init(&err);
+
+        ConnectionType privateConn{dbus_connection_open_private(std::string{address}.c_str(), &err), closeConnection};
+        if (!dbus_error_is_set(&err)) {
+            dbus_bus_register(privateConn.get(), &err);
+        }
+        if (dbus_error_is_set(&err)) {
+            std::string what = std::string{"Could not connect to "}.append(address).append(": ") + err.message;
+            dbus_error_free(&err);
+            throw std::runtime_error(what);
+        }
+        dbus_connection_set_exit_on_disconnect(privateConn.get(), FALSE);
+        return DBus{std::move(privateConn)};
+    }
+
+    [[nodiscard]] inline DBusConnection *get() const { return conn.get(); }
+
     template <typename... Args>
     [[nodiscard]] inline Message makeMessage(std::string_view destination, std::string_view objectPath,
-                                             std::string_view interface, std::string_view method, Args... args) {
+                                             std::string_view interface, std::string_view method,
+                                             const Args &...args) {
         return {destination, objectPath, interface, method, args...};
     }
     Reply sendMessage(const Message &msg, std::chrono::milliseconds timeout = std::chrono::milliseconds(-1)) {
         DBusError err;
         dbus_error_init(&err);
+#ifdef DBUSPP_INSTRUMENTATION
+        Instrumentation::Call call{instrumentation, msg.get()};
+#endif
         auto reply = dbus_connection_send_with_reply_and_block(conn.get(), msg.get(), timeout.count(), &err);
+#ifdef DBUSPP_INSTRUMENTATION
+        call.finish(reply, reply == nullptr);
+#endif
         if (dbus_error_is_set(&err)) {
             throw std::runtime_error(std::string{"DBUS Message failed: "} + err.message);
         }
         return reply;
     }
 
+    template <typename T = void>
+    PendingCall<T> sendMessageAsync(const Message &msg,
+                                    std::chrono::milliseconds timeout = std::chrono::milliseconds(-1)) {
+        DBusPendingCall *pending = nullptr;
+#ifdef DBUSPP_INSTRUMENTATION
+        std::unique_ptr<Instrumentation::Call> call;
+        if (instrumentation) {
+            call = std::make_unique<Instrumentation::Call>(instrumentation, msg.get());
+        }
+#endif
+        if (!dbus_connection_send_with_reply(conn.get(), msg.get(), &pending, static_cast<int>(timeout.count())) ||
+            pending == nullptr) {
+#ifdef DBUSPP_INSTRUMENTATION
+            if (call) {
+                call->finish(nullptr, true);
+            }
+#endif
+            throw std::runtime_error("Could not send dbus message");
+        }
+#ifdef DBUSPP_INSTRUMENTATION
+        if (call) {
+            Instrumentation::track(pending, std::move(call));
+        }
+#endif
+        return PendingCall<T>{pending};
+    }
+
+    // Blocks until every given call (or range of calls) has completed. Outgoing messages are flushed first so all
+    // requests are on the wire before we start waiting, replies are then read in a single pass.
+    template <typename... CALLS> void waitAll(CALLS &...calls) {
+        dbus_connection_flush(conn.get());
+        (waitOne(calls), ...);
+    }
+
     template <typename T = void, typename... ARGS>
     T call(std::string_view destination, std::string_view objectPath, std::string_view interface,
-           std::string_view method, ARGS... args) {
+           std::string_view method, const ARGS &...args) {
         auto msg = makeMessage(destination, objectPath, interface, method, args...);
         auto reply = sendMessage(msg);
         if constexpr (!std::is_same_v<T, void>) {
@@ -107,18 +352,603 @@ class DBus {
         }
     }
 
+    template <typename T = void, typename... ARGS>
+    PendingCall<T> callAsync(std::string_view destination, std::string_view objectPath, std::string_view interface,
+                             std::string_view method, const ARGS &...args) {
+        return sendMessageAsync<T>(makeMessage(destination, objectPath, interface, method, args...));
+    }
+
+    // Calls handler(DBusMessage *) for every matching signal. Empty arguments are wildcards.
+    Subscription subscribeMessage(std::string_view sender, std::string_view path, std::string_view interface,
+                                  std::string_view member, SignalHandler handler) {
+        return {signals, signals->add(sender, path, interface, member, std::move(handler))};
+    }
+
+    // Calls handler(ARGS...) for every matching signal, signals whose arguments do not parse as ARGS are skipped.
+    template <typename... ARGS, typename HANDLER>
+    Subscription subscribe(std::string_view sender, std::string_view path, std::string_view interface,
+                           std::string_view member, HANDLER &&handler) {
+        return subscribeMessage(sender, path, interface, member,
+                                [handler = std::forward<HANDLER>(handler)](DBusMessage *msg) mutable {
+                                    DBusMessageIter iter;
+                                    dbus_message_iter_init(msg, &iter);
+                                    std::optional<std::tuple<ARGS...>> args;
+                                    try {
+                                        args = parsers::parseArguments<ARGS...>(&iter);
+                                    } catch (const parsers::ParseException &) {
+                                        return;
+                                    }
+                                    std::apply(handler, std::move(*args));
+                                });
+    }
+
+#ifdef DBUSPP_INSTRUMENTATION
+    // Records the method calls made on this connection in instrumentation, which may be shared by connections. Set it
+    // before making calls, nullptr stops recording.
+    void instrument(std::shared_ptr<Instrumentation> instrumentation) {
+        this->instrumentation = std::move(instrumentation);
+    }
+    [[nodiscard]] const std::shared_ptr<Instrumentation> &getInstrumentation() const { return instrumentation; }
+#endif
+
+    // Requests a well known name for this connection, returns whether we became its primary owner.
+    bool requestName(std::string_view name, unsigned int flags = DBUS_NAME_FLAG_DO_NOT_QUEUE) {
+        DBusError err;
+        dbus_error_init(&err);
+        int result = dbus_bus_request_name(conn.get(), std::string{name}.c_str(), flags, &err);
+        if (dbus_error_is_set(&err)) {
+            std::string what = std::string{"Could not request name: "} + err.message;
+            dbus_error_free(&err);
+            throw std::runtime_error(what);
+        }
+        return result == DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER || result == DBUS_REQUEST_NAME_REPLY_ALREADY_OWNER;
+    }
+
+    void releaseName(std::string_view name) {
+        DBusError err;
+        dbus_error_init(&err);
+        dbus_bus_release_name(conn.get(), std::string{name}.c_str(), &err);
+        if (dbus_error_is_set(&err)) {
+            std::string what = std::string{"Could not release name: "} + err.message;
+            dbus_error_free(&err);
+            throw std::runtime_error(what);
+        }
+    }
+
   private:
+    class SignalRouter {
+      public:
+        // Without a bus there are no match rules, a peer sends all of its signals.
+        SignalRouter(DBusConnection *conn, bool bus) : conn(dbus_connection_ref(conn)), bus(bus) {
+            if (!dbus_connection_add_filter(conn, filter, this, nullptr)) {
+                dbus_connection_unref(conn);
+                throw std::runtime_error("Could not install dbus signal filter");
+            }
+        }
+        SignalRouter(const SignalRouter &) = delete;
+        SignalRouter(SignalRouter &&) = delete;
+        SignalRouter &operator=(const SignalRouter &) = delete;
+        SignalRouter &operator=(SignalRouter &&) = delete;
+        ~SignalRouter() {
+            dbus_connection_remove_filter(conn, filter, this);
+            for (const auto &[hash, bucket] : table) {
+                for (const auto &entry : *bucket) {
+                    removeMatch(entry.rule);
+                }
+            }
+            for (const auto &[name, owner] : owners) {
+                removeMatch(ownerRule(name));
+            }
+            dbus_connection_unref(conn);
+        }
+
+        uint64_t add(std::string_view sender, std::string_view path, std::string_view interface,
+                     std::string_view member, SignalHandler handler) {
+            Entry entry{0,
+                        std::string{sender},
+                        std::string{path},
+                        std::string{interface},
+                        std::string{member},
+                        matchRule(sender, path, interface, member),
+                        std::make_shared<Slot>(std::move(handler))};
+
+            if (bus) {
+                DBusError err;
+                dbus_error_init(&err);
+                dbus_bus_add_match(conn, entry.rule.c_str(), &err);
+                if (dbus_error_is_set(&err)) {
+                    std::string what = std::string{"Could not add match rule: "} + err.message;
+                    dbus_error_free(&err);
+                    throw std::runtime_error(what);
+                }
+            }
+            if (isWellKnown(entry.sender)) {
+                try {
+                    trackOwner(entry.sender);
+                } catch (...) {
+                    removeMatch(entry.rule);
+                    throw;
+                }
+            }
+
+            std::lock_guard lock(mutex);
+            entry.id = ++lastId;
+            ++patterns[pattern(entry)];
+            auto &bucket = table[hashKey(entry.interface, entry.member, entry.path)];
+            auto updated = bucket ? std::make_shared<Bucket>(*bucket) : std::make_shared<Bucket>();
+            updated->push_back(std::move(entry));
+            bucket = std::move(updated);
+            return lastId;
+        }
+
+        // Once this returns the handler is not running and will not be called again, unless it is removed from within a
+        // handler, in which case the running handlers are left to finish.
+        void remove(uint64_t id) {
+            std::string rule;
+            std::string sender;
+            bool dropOwner = false;
+            {
+                std::unique_lock lock(mutex);
+                std::shared_ptr<Slot> slot;
+                for (auto it = table.begin(); it != table.end() && !slot; ++it) {
+                    auto &bucket = it->second;
+                    auto found =
+                        std::find_if(bucket->begin(), bucket->end(), [id](const auto &e) { return e.id == id; });
+                    if (found == bucket->end()) {
+                        continue;
+                    }
+                    rule = found->rule;
+                    sender = found->sender;
+                    slot = found->slot;
+                    --patterns[pattern(*found)];
+                    if (bucket->size() == 1) {
+                        table.erase(it);
+                    } else {
+                        auto updated = std::make_shared<Bucket>(*bucket);
+                        updated->erase(updated->begin() + (found - bucket->begin()));
+                        bucket = std::move(updated);
+                    }
+                }
+                if (!slot) {
+                    return;
+                }
+                // Dispatching may still hold the old bucket, it skips removed slots and is waited for otherwise.
+                slot->removed = true;
+                if (dispatcher != std::this_thread::get_id()) {
+                    idle.wait(lock, [&slot] { return slot->calls == 0; });
+                }
+                if (auto owner = owners.find(sender); owner != owners.end() && --owner->second.refs == 0) {
+                    owners.erase(owner);
+                    dropOwner = true;
+                }
+            }
+            removeMatch(rule);
+            if (dropOwner) {
+                removeMatch(ownerRule(sender));
+            }
+        }
+
+      private:
+        // A handler and the number of dispatches currently running it, guarded by the mutex of the router.
+        struct Slot {
+            explicit Slot(SignalHandler handler) : handler(std::move(handler)) {}
+            SignalHandler handler;
+            std::size_t calls{0};
+            bool removed{false};
+        };
+        struct Entry {
+            uint64_t id;
+            std::string sender;
+            std::string path;
+            std::string interface;
+            std::string member;
+            std::string rule;
+            std::shared_ptr<Slot> slot;
+        };
+        // Buckets are copied on write so dispatching can run without holding the lock.
+        using Bucket = std::vector<Entry>;
+        // The unique name currently owning a well known sender name, empty when it has no owner.
+        struct Owner {
+            std::string unique;
+            std::size_t refs;
+        };
+
+        static std::size_t hashKey(std::string_view interface, std::string_view member, std::string_view path) {
+            std::hash<std::string_view> hasher;
+            auto hash = hasher(interface);
+            hash ^= hasher(member) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            hash ^= hasher(path) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+
+        static std::string matchRule(std::string_view sender, std::string_view path, std::string_view interface,
+                                     std::string_view member) {
+            std::string rule = "type='signal'";
+            for (const auto &[key, value] : {std::make_pair("sender", sender), std::make_pair("path", path),
+                                             std::make_pair("interface", interface),
+                                             std::make_pair("member", member)}) {
+                if (!value.empty()) {
+                    rule.append(",").append(key).append("='").append(value).append("'");
+                }
+            }
+            return rule;
+        }
+
+        // Which of interface, member and path are set, used to only look up wildcard keys that are in use.
+        enum Pattern : unsigned int { hasInterface = 1, hasMember = 2, hasPath = 4, patternCount = 8 };
+        static unsigned int pattern(const Entry &entry) {
+            return (entry.interface.empty() ? 0U : hasInterface) | (entry.member.empty() ? 0U : hasMember) |
+                   (entry.path.empty() ? 0U : hasPath);
+        }
+
+        static std::string_view view(const char *str) { return str ? str : ""; }
+
+        // Signals carry the unique name of their sender, so subscriptions to a well known name are matched against its
+        // current owner. A peer has no names at all.
+        [[nodiscard]] bool isWellKnown(std::string_view sender) const {
+            return bus && !sender.empty() && sender[0] != ':' && sender != DBUS_SERVICE_DBUS;
+        }
+
+        static std::string ownerRule(std::string_view name) {
+            return std::string{"type='signal',sender='"} + DBUS_SERVICE_DBUS + "',path='" + DBUS_PATH_DBUS +
+                   "',interface='" + DBUS_INTERFACE_DBUS + "',member='NameOwnerChanged',arg0='" + std::string{name} +
+                   "'";
+        }
+
+        // Follows NameOwnerChanged of name before asking for its owner, so no change can be missed in between.
+        void trackOwner(const std::string &name) {
+            {
+                std::lock_guard lock(mutex);
+                if (auto it = owners.find(name); it != owners.end()) {
+                    ++it->second.refs;
+                    return;
+                }
+            }
+            auto rule = ownerRule(name);
+            DBusError err;
+            dbus_error_init(&err);
+            dbus_bus_add_match(conn, rule.c_str(), &err);
+            if (dbus_error_is_set(&err)) {
+                std::string what = std::string{"Could not add match rule: "} + err.message;
+                dbus_error_free(&err);
+                throw std::runtime_error(what);
+            }
+
+            std::string unique;
+            DBusMessage *msg = dbus_message_new_method_call(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS,
+                                                            "GetNameOwner");
+            const char *namePtr = name.c_str();
+            if (msg != nullptr && dbus_message_append_args(msg, DBUS_TYPE_STRING, &namePtr, DBUS_TYPE_INVALID)) {
+                // Fails with NameHasNoOwner while nobody owns the name.
+                if (DBusMessage *reply = dbus_connection_send_with_reply_and_block(conn, msg, -1, nullptr)) {
+                    const char *owner = nullptr;
+                    if (dbus_message_get_args(reply, nullptr, DBUS_TYPE_STRING, &owner, DBUS_TYPE_INVALID)) {
+                        unique = owner;
+                    }
+                    dbus_message_unref(reply);
+                }
+            }
+            if (msg != nullptr) {
+                dbus_message_unref(msg);
+            }
+
+            std::lock_guard lock(mutex);
+            auto [it, inserted] = owners.try_emplace(name, Owner{std::move(unique), 0});
+            ++it->second.refs;
+            if (!inserted) {
+                // Tracked by another thread meanwhile, which added its own match rule.
+                removeMatch(rule);
+            }
+        }
+
+        void onNameOwnerChanged(DBusMessage *msg) {
+            const char *name = nullptr;
+            const char *oldOwner = nullptr;
+            const char *newOwner = nullptr;
+            if (!dbus_message_get_args(msg, nullptr, DBUS_TYPE_STRING, &name, DBUS_TYPE_STRING, &oldOwner,
+                                       DBUS_TYPE_STRING, &newOwner, DBUS_TYPE_INVALID)) {
+                return;
+            }
+            std::lock_guard lock(mutex);
+            if (auto it = owners.find(std::string_view{name}); it != owners.end()) {
+                it->second.unique = newOwner;
+            }
+        }
+
+        [[nodiscard]] bool fromSender(const std::string &expected, std::string_view sender) {
+            if (expected.empty() || !bus) {
+                return true;
+            }
+            if (!isWellKnown(expected)) {
+                return expected == sender;
+            }
+            std::lock_guard lock(mutex);
+            auto it = owners.find(expected);
+            return it != owners.end() && it->second.unique == sender;
+        }
+
+        // Runs a handler unless it was removed, while counting it as in use.
+        void invoke(Slot &slot, DBusMessage *msg) {
+            {
+                std::lock_guard lock(mutex);
+                if (slot.removed) {
+                    return;
+                }
+                ++slot.calls;
+            }
+            struct Release {
+                SignalRouter &router;
+                Slot &slot;
+                ~Release() {
+                    {
+                        std::lock_guard lock(router.mutex);
+                        --slot.calls;
+                    }
+                    router.idle.notify_all();
+                }
+            } release{*this, slot};
+            slot.handler(msg);
+        }
+
+        void removeMatch(const std::string &rule) {
+            if (bus) {
+                dbus_bus_remove_match(conn, rule.c_str(), nullptr);
+            }
+        }
+
+        void dispatch(DBusMessage *msg) {
+            // libdbus lets only one thread dispatch a connection at a time, remove() must not wait for it.
+            struct Dispatching {
+                SignalRouter &router;
+                explicit Dispatching(SignalRouter &router) : router(router) { set(std::this_thread::get_id()); }
+                ~Dispatching() { set(std::thread::id{}); }
+                void set(std::thread::id id) {
+                    std::lock_guard lock(router.mutex);
+                    router.dispatcher = id;
+                }
+            } dispatching{*this};
+
+            auto sender = view(dbus_message_get_sender(msg));
+            auto path = view(dbus_message_get_path(msg));
+            auto interface = view(dbus_message_get_interface(msg));
+            auto member = view(dbus_message_get_member(msg));
+
+            for (unsigned int mask = 0; mask < patternCount; ++mask) {
+                auto keyInterface = (mask & hasInterface) ? interface : std::string_view{};
+                auto keyMember = (mask & hasMember) ? member : std::string_view{};
+                auto keyPath = (mask & hasPath) ? path : std::string_view{};
+                std::shared_ptr<const Bucket> bucket;
+                {
+                    std::lock_guard lock(mutex);
+                    if (patterns[mask] == 0) {
+                        continue;
+                    }
+                    auto it = table.find(hashKey(keyInterface, keyMember, keyPath));
+                    if (it == table.end()) {
+                        continue;
+                    }
+                    bucket = it->second;
+                }
+                for (const auto &entry : *bucket) {
+                    if (entry.interface != keyInterface || entry.member != keyMember || entry.path != keyPath) {
+                        continue;
+                    }
+                    // Match rules apply to the whole connection, a broader rule also delivers other senders.
+                    if (!fromSender(entry.sender, sender)) {
+                        continue;
+                    }
+                    invoke(*entry.slot, msg);
+                }
+            }
+        }
+
+        static DBusHandlerResult filter(DBusConnection *, DBusMessage *msg, void *data) {
+            if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_SIGNAL) {
+                return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+            }
+            auto *router = static_cast<SignalRouter *>(data);
+            if (router->bus && dbus_message_is_signal(msg, DBUS_INTERFACE_DBUS, "NameOwnerChanged") &&
+                view(dbus_message_get_sender(msg)) == DBUS_SERVICE_DBUS) {
+                router->onNameOwnerChanged(msg);
+            }
+            router->dispatch(msg);
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        }
+
+        DBusConnection *conn;
+        bool bus;
+        std::mutex mutex;
+        std::condition_variable idle;
+        std::thread::id dispatcher;
+        uint64_t lastId{0};
+        std::array<std::size_t, patternCount> patterns{};
+        std::unordered_map<std::size_t, std::shared_ptr<const Bucket>> table;
+        std::map<std::string, Owner, std::less<>> owners;
+    };
+
+    template <typename T> static void waitOne(PendingCall<T> &pending) { pending.wait(); }
+    template <typename RANGE> static void waitOne(RANGE &range) {
+        for (auto &pending : range) {
+            pending.wait();
+        }
+    }
+
+  protected:
     using ConnectionType = std::unique_ptr<DBusConnection, void (*)(DBusConnection *)>;
+
+    // bus is false for connections to a peer instead of a message bus.
+    explicit DBus(ConnectionType connection, bool bus = true) : conn(std::move(connection)) {
+        signals = std::make_shared<SignalRouter>(conn.get(), bus);
+    }
+
+    static void closeConnection(DBusConnection *connection) {
+        dbus_connection_close(connection);
+        dbus_connection_unref(connection);
+    }
+
+  private:
     ConnectionType conn{nullptr, dbus_connection_unref};
+    std::shared_ptr<SignalRouter> signals;
+#ifdef DBUSPP_INSTRUMENTATION
+    std::shared_ptr<Instrumentation> instrumentation;
+#endif
+};
+
+// A set of private connections to the same bus. Threads that each use their own connection no longer contend on a
+// single connection, and a slow reply on one connection does not stall callers on the others.
+class ConnectionPool {
+  public:
+    explicit ConnectionPool(std::size_t size = std::max(1U, std::thread::hardware_concurrency()),
+                            DBusBusType busType = DBUS_BUS_SYSTEM) {
+        connections.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            connections.push_back(DBus::openPrivate(busType));
+        }
+    }
+
+    // The connection assigned to the calling thread, threads are spread evenly on first use.
+    DBus &local() {
+        static std::atomic<std::size_t> threadCounter{0};
+        thread_local std::size_t threadIndex = threadCounter++;
+        return connections[threadIndex % connections.size()];
+    }
+
+    // Hands out connections round-robin.
+    DBus &next() { return connections[counter++ % connections.size()]; }
+
+    DBus &operator[](std::size_t index) { return connections.at(index); }
+#ifdef DBUSPP_INSTRUMENTATION
+    void instrument(const std::shared_ptr<Instrumentation> &instrumentation) {
+        for (auto &connection : connections) {
+            connection.instrument(instrumentation);
+        }
+    }
+#endif
+    [[nodiscard]] std::size_t size() const { return connections.size(); }
+    auto begin() { return connections.begin(); }
+    auto end() { return connections.end(); }
+
+  private:
+    std::vector<DBus> connections;
+    std::atomic<std::size_t> counter{0};
+};
+
+template <typename SIGNATURE> class PreparedCall;
+
+// A method call that is set up once and invoked many times. The header is built a single time, every invocation copies
+// it and only marshals the arguments.
+template <typename RET, typename... ARGS> class PreparedCall<RET(ARGS...)> {
+  public:
+    PreparedCall(DBus *dbus, std::string destination, std::string path, std::string interface, std::string method,
+                 std::chrono::milliseconds timeout = std::chrono::milliseconds(-1))
+        : dbus(dbus), timeout(timeout), destination(std::move(destination)), path(std::move(path)),
+          interface(std::move(interface)), method(std::move(method)),
+          prototype(this->destination, this->path, this->interface, this->method) {}
+
+    [[nodiscard]] static constexpr std::string_view signature() { return SIGNATURE.view(); }
+
+    [[nodiscard]] DBus::Message makeMessage(const ARGS &...args) const {
+        DBus::Message msg{dbus_message_copy(prototype.get())};
+        if constexpr (sizeof...(ARGS) > 0) {
+            msg.addArguments(args...);
+        }
+        return msg;
+    }
+
+    RET operator()(const ARGS &...args) const {
+        auto reply = dbus->sendMessage(makeMessage(args...), timeout);
+        if constexpr (!std::is_same_v<RET, void>) {
+            return reply.template response<RET>();
+        }
+    }
+
+    DBus::PendingCall<RET> async(const ARGS &...args) const {
+        return dbus->sendMessageAsync<RET>(makeMessage(args...), timeout);
+    }
+
+  private:
+    static constexpr auto SIGNATURE =
+        parsers::concatSignatures(parsers::Parser<std::decay_t<const ARGS>>::signature...);
+
+    DBus *dbus;
+    std::chrono::milliseconds timeout;
+    std::string destination;
+    std::string path;
+    std::string interface;
+    std::string method;
+    DBus::Message prototype;
+};
+
+// A single value inside a received message, parsed on demand. Keeps the message alive.
+class MessageValue {
+  public:
+    using MessagePtr = std::shared_ptr<DBusMessage>;
+
+    MessageValue(MessagePtr msg, const DBusMessageIter &iter) : msg(std::move(msg)), iter(iter) {}
+
+    static MessagePtr share(DBusMessage *msg) { return {dbus_message_ref(msg), dbus_message_unref}; }
+
+    // The value is the content of the variant iter points at.
+    static MessageValue fromVariant(MessagePtr msg, DBusMessageIter *iter) {
+        if (auto type = dbus_message_iter_get_arg_type(iter); type != DBUS_TYPE_VARIANT) {
+            throw parsers::ParseException(type, DBUS_TYPE_VARIANT);
+        }
+        DBusMessageIter subIter;
+        dbus_message_iter_recurse(iter, &subIter);
+        return {std::move(msg), subIter};
+    }
+
+    // Calls callback(std::string_view name, MessageValue value) for every entry of the a{sv} iter points at.
+    template <typename CALLBACK>
+    static void forEachProperty(const MessagePtr &msg, DBusMessageIter *iter, CALLBACK &&callback) {
+        if (auto type = dbus_message_iter_get_arg_type(iter); type != DBUS_TYPE_ARRAY) {
+            throw parsers::ParseException(type, DBUS_TYPE_ARRAY);
+        }
+        DBusMessageIter arrayIter;
+        dbus_message_iter_recurse(iter, &arrayIter);
+        for (; dbus_message_iter_get_arg_type(&arrayIter) == DBUS_TYPE_DICT_ENTRY; dbus_message_iter_next(&arrayIter)) {
+            DBusMessageIter entryIter;
+            dbus_message_iter_recurse(&arrayIter, &entryIter);
+            if (auto type = dbus_message_iter_get_arg_type(&entryIter); type != DBUS_TYPE_STRING) {
+                throw parsers::ParseException(type, DBUS_TYPE_STRING);
+            }
+            const char *name = nullptr;
+            dbus_message_iter_get_basic(&entryIter, &name);
+            dbus_message_iter_next(&entryIter);
+            callback(std::string_view{name}, fromVariant(msg, &entryIter));
+        }
+    }
+
+    // Views are not allowed, the message may be dropped by a cache as soon as the value has been copied out.
+    template <typename T> [[nodiscard]] T get() const {
+        static_assert(!parsers::containsView<T>, "Views can only be parsed with Reply::view<T>()");
+        DBusMessageIter copy = iter;
+        return parsers::Parser<T>::parse(&copy);
+    }
+
+    [[nodiscard]] int type() const {
+        DBusMessageIter copy = iter;
+        return dbus_message_iter_get_arg_type(&copy);
+    }
+
+  private:
+    MessagePtr msg;
+    DBusMessageIter iter;
 };
 
 class Interface {
   public:
     Interface(DBus *dbus, std::string destination, std::string path)
         : dbus(dbus), destination(std::move(destination)), path(std::move(path)) {}
+    // Calls are made on the pool connection of the calling thread.
+    Interface(ConnectionPool *pool, std::string destination, std::string path)
+        : pool(pool), destination(std::move(destination)), path(std::move(path)) {}
 
   protected:
-    DBus *dbus;
+    DBus &connection() const { return pool ? pool->local() : *dbus; }
+
+    DBus *dbus{nullptr};
+    ConnectionPool *pool{nullptr};
     std::string destination;
     std::string path;
 };
@@ -128,19 +958,304 @@ class Properties : public Interface {
     using Interface::Interface;
 
     template <typename T> [[nodiscard]] T get(std::string_view interface, std::string_view property) {
-        return std::get<T>(dbus->call<std::variant<T>>(destination, path, DBUS_PROPS, "Get", interface, property));
+        return std::get<T>(
+            connection().call<std::variant<T>>(destination, path, DBUS_PROPS, "Get", interface, property));
     }
 
     template <typename T> [[nodiscard]] type::Dict<type::String, T> getAll(std::string_view interface) {
-        return dbus->call<type::Dict<type::String, T>>(destination, path, DBUS_PROPS, "GetAll", interface);
+        return connection().call<type::Dict<type::String, T>>(destination, path, DBUS_PROPS, "GetAll", interface);
     }
 
     template <typename T> void set(std::string_view interface, std::string_view property, const T &value) {
-        dbus->call<void>(destination, path, DBUS_PROPS, "Set", interface, property, value);
+        connection().call<void>(destination, path, DBUS_PROPS, "Set", interface, property, type::Variant<T>{value});
+    }
+};
+
+// Properties that are read from a local cache. Each interface is primed with a single GetAll on first use, after which
+// the cache is kept current through PropertiesChanged signals, which requires the connection to be dispatched by a
+// main loop. Invalidated properties are fetched again with Get on their next read.
+class CachedProperties : public Properties {
+  public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t invalidations;
+    };
+
+    CachedProperties(DBus *dbus, std::string destination, std::string path)
+        : Properties(dbus, std::move(destination), std::move(path)), subscription(subscribe()) {}
+    // Pins the pool connection of the constructing thread, signals and replies must arrive on the same connection to
+    // stay in order.
+    CachedProperties(ConnectionPool *pool, std::string destination, std::string path)
+        : CachedProperties(&pool->local(), std::move(destination), std::move(path)) {}
+    CachedProperties(const CachedProperties &) = delete;
+    CachedProperties(CachedProperties &&) = delete;
+    CachedProperties &operator=(const CachedProperties &) = delete;
+    CachedProperties &operator=(CachedProperties &&) = delete;
+    ~CachedProperties() = default;
+
+    template <typename T> [[nodiscard]] T get(std::string_view interface, std::string_view property) {
+        if (auto value = lookup(interface, property)) {
+            ++hits;
+            return value->template get<T>();
+        }
+        ++misses;
+        fetch(interface, property);
+        if (auto value = lookup(interface, property)) {
+            return value->template get<T>();
+        }
+        throw std::runtime_error(std::string{"No such property: "}.append(interface).append(".").append(property));
+    }
+
+    // Drops all cached values, the next read of every interface performs a GetAll again.
+    void invalidate() {
+        std::lock_guard lock(mutex);
+        cache.clear();
+    }
+
+    [[nodiscard]] Stats stats() const { return {hits.load(), misses.load(), invalidations.load()}; }
+
+  private:
+    using PropertyMap = std::map<std::string, MessageValue, std::less<>>;
+
+    DBus::Subscription subscribe() {
+        return connection().subscribeMessage(destination, path, DBUS_PROPS, "PropertiesChanged",
+                                             [this](DBusMessage *msg) { onPropertiesChanged(msg); });
+    }
+
+    std::optional<MessageValue> lookup(std::string_view interface, std::string_view property) {
+        std::lock_guard lock(mutex);
+        if (auto iface = cache.find(interface); iface != cache.end()) {
+            if (auto value = iface->second.find(property); value != iface->second.end()) {
+                return value->second;
+            }
+        }
+        return std::nullopt;
+    }
+
+    PropertyMap &interfaceCache(std::string_view interface) {
+        auto it = cache.find(interface);
+        if (it == cache.end()) {
+            it = cache.emplace(std::string{interface}, PropertyMap{}).first;
+        }
+        return it->second;
+    }
+
+    // Changes dispatched while a Get or GetAll of their interface is in flight may be newer than its result, they are
+    // recorded and applied over it once it is inserted.
+    struct Fetching {
+        std::size_t calls{0};
+        std::vector<MessageValue::MessagePtr> changes;
+    };
+
+    void fetch(std::string_view interface, std::string_view property) {
+        bool primed = false;
+        {
+            std::lock_guard lock(mutex);
+            primed = cache.find(interface) != cache.end();
+            auto it = fetching.find(interface);
+            if (it == fetching.end()) {
+                it = fetching.emplace(std::string{interface}, Fetching{}).first;
+            }
+            ++it->second.calls;
+        }
+        try {
+            auto &bus = connection();
+            auto call = primed ? bus.makeMessage(destination, path, DBUS_PROPS, "Get", interface, property)
+                               : bus.makeMessage(destination, path, DBUS_PROPS, "GetAll", interface);
+            auto reply = bus.sendMessage(call);
+            auto msg = MessageValue::share(reply.get());
+            DBusMessageIter iter;
+            dbus_message_iter_init(msg.get(), &iter);
+            // Parsed before locking, a malformed reply leaves the cache untouched.
+            PropertyMap received;
+            if (primed) {
+                received.insert_or_assign(std::string{property}, MessageValue::fromVariant(msg, &iter));
+            } else {
+                MessageValue::forEachProperty(msg, &iter, [&received](std::string_view name, MessageValue value) {
+                    received.insert_or_assign(std::string{name}, std::move(value));
+                });
+            }
+
+            std::lock_guard lock(mutex);
+            auto &properties = interfaceCache(interface);
+            for (auto &[name, value] : received) {
+                properties.insert_or_assign(name, std::move(value));
+            }
+            auto it = fetching.find(interface);
+            for (const auto &change : it->second.changes) {
+                applyChange(properties, change);
+            }
+            finishFetch(it);
+        } catch (...) {
+            std::lock_guard lock(mutex);
+            finishFetch(fetching.find(interface));
+            throw;
+        }
+    }
+
+    void finishFetch(std::map<std::string, Fetching, std::less<>>::iterator it) {
+        if (--it->second.calls == 0) {
+            fetching.erase(it);
+        }
+    }
+
+    // Applies the changed and invalidated properties of a PropertiesChanged signal.
+    void applyChange(PropertyMap &properties, const MessageValue::MessagePtr &msg) {
+        DBusMessageIter iter;
+        if (!dbus_message_iter_init(msg.get(), &iter) || !dbus_message_iter_next(&iter)) {
+            return;
+        }
+        try {
+            MessageValue::forEachProperty(msg, &iter, [&properties](std::string_view name, MessageValue value) {
+                properties.insert_or_assign(std::string{name}, std::move(value));
+            });
+            dbus_message_iter_next(&iter);
+            for (const auto &name : parsers::Parser<type::Array<type::String>>::parse(&iter)) {
+                if (properties.erase(name) > 0) {
+                    ++invalidations;
+                }
+            }
+        } catch (const parsers::ParseException &) {
+            // Malformed signal, keep what was applied.
+        }
+    }
+
+    void onPropertiesChanged(DBusMessage *signal) {
+        auto msg = MessageValue::share(signal);
+        DBusMessageIter iter;
+        if (!dbus_message_iter_init(msg.get(), &iter) || dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) {
+            return;
+        }
+        const char *interface = nullptr;
+        dbus_message_iter_get_basic(&iter, &interface);
+
+        std::lock_guard lock(mutex);
+        if (auto it = fetching.find(std::string_view{interface}); it != fetching.end()) {
+            it->second.changes.push_back(msg);
+        }
+        if (auto iface = cache.find(std::string_view{interface}); iface != cache.end()) {
+            applyChange(iface->second, msg);
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::map<std::string, PropertyMap, std::less<>> cache;
+    std::map<std::string, Fetching, std::less<>> fetching;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> invalidations{0};
+    DBus::Subscription subscription;
+};
+
+// Collects property reads and performs them together, with one GetAll per object and interface. All GetAll calls are
+// sent before waiting for the first reply, so reading many properties of many objects costs a single burst of round
+// trips. Handles returned by get() can be read once run() has returned.
+class PropertyBatch {
+  private:
+    struct Group {
+        std::string path;
+        std::string interface;
+        std::map<std::string, MessageValue, std::less<>> properties;
+        std::string error;
+        bool done{false};
+    };
+
+  public:
+    template <typename T> class Handle {
+      public:
+        // Throws when the property does not exist or the GetAll of its interface failed.
+        [[nodiscard]] T get() const {
+            auto value = group->properties.find(property);
+            if (value == group->properties.end()) {
+                throw std::runtime_error(missing());
+            }
+            return value->second.template get<T>();
+        }
+
+        [[nodiscard]] bool found() const {
+            return group->done && group->properties.find(property) != group->properties.end();
+        }
+
+      private:
+        friend class PropertyBatch;
+        Handle(std::shared_ptr<const Group> group, std::string property)
+            : group(std::move(group)), property(std::move(property)) {}
+
+        [[nodiscard]] std::string missing() const {
+            if (!group->done) {
+                return "PropertyBatch::run() has not been called";
+            }
+            if (!group->error.empty()) {
+                return group->error;
+            }
+            return "No such property: " + group->path + " " + group->interface + "." + property;
+        }
+
+        std::shared_ptr<const Group> group;
+        std::string property;
+    };
+
+    PropertyBatch(DBus *dbus, std::string destination) : dbus(dbus), destination(std::move(destination)) {}
+    // Calls are made on the pool connection of the thread calling run().
+    PropertyBatch(ConnectionPool *pool, std::string destination) : pool(pool), destination(std::move(destination)) {}
+
+    // Records a read, the value is available from the handle after the next run().
+    template <typename T>
+    [[nodiscard]] Handle<T> get(std::string_view objectPath, std::string_view interface, std::string_view property) {
+        auto key = std::make_pair(std::string{objectPath}, std::string{interface});
+        auto it = groups.find(key);
+        if (it == groups.end()) {
+            auto group = std::make_shared<Group>();
+            group->path = key.first;
+            group->interface = key.second;
+            it = groups.emplace(std::move(key), std::move(group)).first;
+        }
+        return {it->second, std::string{property}};
+    }
+
+    // Number of GetAll calls the next run() makes.
+    [[nodiscard]] std::size_t size() const { return groups.size(); }
+
+    // Sends all recorded GetAll calls and waits for their replies. A failed call only fails the handles of its own
+    // object and interface. Afterwards the batch is empty and can be used for the next round. When sending throws,
+    // the recorded reads are kept.
+    void run() {
+        auto &bus = pool ? pool->local() : *dbus;
+        std::vector<std::shared_ptr<Group>> pending;
+        std::vector<DBus::PendingCall<>> calls;
+        pending.reserve(groups.size());
+        calls.reserve(groups.size());
+        for (const auto &[key, group] : groups) {
+            calls.push_back(bus.callAsync(destination, group->path, DBUS_PROPS, "GetAll", group->interface));
+            pending.push_back(group);
+        }
+        groups.clear();
+        bus.waitAll(calls);
+
+        for (std::size_t i = 0; i < calls.size(); ++i) {
+            auto &group = *pending[i];
+            try {
+                auto reply = calls[i].reply();
+                auto msg = MessageValue::share(reply.get());
+                DBusMessageIter iter;
+                dbus_message_iter_init(msg.get(), &iter);
+                MessageValue::forEachProperty(msg, &iter, [&group](std::string_view name, MessageValue value) {
+                    group.properties.insert_or_assign(std::string{name}, std::move(value));
+                });
+            } catch (const std::exception &e) {
+                group.properties.clear();
+                group.error = e.what();
+            }
+            group.done = true;
+        }
     }
 
   private:
-    static inline constexpr std::string_view DBUS_PROPS = "org.freedesktop.DBus.Properties";
+    DBus *dbus{nullptr};
+    ConnectionPool *pool{nullptr};
+    std::string destination;
+    std::map<std::pair<std::string, std::string>, std::shared_ptr<Group>> groups;
 };
 
 class Introspectable : public Interface {
@@ -148,7 +1263,7 @@ class Introspectable : public Interface {
     using Interface::Interface;
 
     type::String introspect() {
-        return dbus->call<std::string>(destination, path, "org.freedesktop.DBus.Introspectable", "Introspect");
+        return connection().call<std::string>(destination, path, "org.freedesktop.DBus.Introspectable", "Introspect");
     }
 };
 
@@ -156,9 +1271,9 @@ class Peer : public Interface {
   public:
     using Interface::Interface;
 
-    void ping() { return dbus->call<void>(destination, path, "org.freedesktop.DBus.Peer", "Ping"); }
+    void ping() { return connection().call<void>(destination, path, "org.freedesktop.DBus.Peer", "Ping"); }
     type::String getMachineId() {
-        return dbus->call<type::String>(destination, path, "org.freedesktop.DBus.Peer", "GetMachineId");
+        return connection().call<type::String>(destination, path, "org.freedesktop.DBus.Peer", "GetMachineId");
     }
 };
 
@@ -168,8 +1283,306 @@ class ObjectManager : public Interface {
 
     auto getManagedObjects() {
         using CallType = type::Dict<type::ObjectPath, type::Dict<type::String, type::Dict<type::String, type::Ignore>>>;
-        return dbus->call<CallType>(destination, path, "org.freedesktop.DBus.ObjectManager", "GetManagedObjects");
+        return connection().call<CallType>(destination, path, "org.freedesktop.DBus.ObjectManager",
+                                           "GetManagedObjects");
+    }
+};
+
+// A local copy of the objects of an ObjectManager. A single GetManagedObjects call fills it, after that it is kept up
+// to date from InterfacesAdded and InterfacesRemoved and, when trackProperties is set, from PropertiesChanged of the
+// managed objects. Values of invalidated properties are dropped. The connection must be dispatched for updates.
+class ObjectManagerMirror : public ObjectManager {
+  public:
+    using PropertyMap = std::map<std::string, MessageValue, std::less<>>;
+    using InterfaceMap = std::map<std::string, PropertyMap, std::less<>>;
+
+    enum class Change { InterfaceAdded, InterfaceRemoved, PropertiesChanged };
+    // Called for every interface of an object that changed, without holding the lock of the mirror.
+    using ChangeCallback = std::function<void(Change change, std::string_view path, std::string_view interface)>;
+
+    ObjectManagerMirror(DBus *dbus, std::string destination, std::string path, bool trackProperties = false)
+        : ObjectManager(dbus, std::move(destination), std::move(path)) {
+        start(trackProperties);
     }
+    // Pins the pool connection of the constructing thread, like CachedProperties.
+    ObjectManagerMirror(ConnectionPool *pool, std::string destination, std::string path, bool trackProperties = false)
+        : ObjectManagerMirror(&pool->local(), std::move(destination), std::move(path), trackProperties) {}
+    ObjectManagerMirror(const ObjectManagerMirror &) = delete;
+    ObjectManagerMirror(ObjectManagerMirror &&) = delete;
+    ObjectManagerMirror &operator=(const ObjectManagerMirror &) = delete;
+    ObjectManagerMirror &operator=(ObjectManagerMirror &&) = delete;
+    ~ObjectManagerMirror() = default;
+
+    void onChange(ChangeCallback callback) {
+        std::lock_guard lock(mutex);
+        callbacks.push_back(std::make_shared<const ChangeCallback>(std::move(callback)));
+    }
+
+    [[nodiscard]] std::vector<std::string> objects() const {
+        std::lock_guard lock(mutex);
+        std::vector<std::string> paths;
+        paths.reserve(tree.size());
+        for (const auto &[objectPath, interfaces] : tree) {
+            paths.push_back(objectPath);
+        }
+        return paths;
+    }
+
+    [[nodiscard]] std::vector<std::string> objectsImplementing(std::string_view interface) const {
+        std::lock_guard lock(mutex);
+        auto it = byInterface.find(interface);
+        return it == byInterface.end() ? std::vector<std::string>{}
+                                       : std::vector<std::string>{it->second.begin(), it->second.end()};
+    }
+
+    [[nodiscard]] bool contains(std::string_view objectPath) const {
+        std::lock_guard lock(mutex);
+        return tree.find(objectPath) != tree.end();
+    }
+
+    [[nodiscard]] bool implements(std::string_view objectPath, std::string_view interface) const {
+        std::lock_guard lock(mutex);
+        auto object = tree.find(objectPath);
+        return object != tree.end() && object->second.find(interface) != object->second.end();
+    }
+
+    [[nodiscard]] std::optional<InterfaceMap> interfaces(std::string_view objectPath) const {
+        std::lock_guard lock(mutex);
+        auto object = tree.find(objectPath);
+        return object == tree.end() ? std::nullopt : std::optional<InterfaceMap>{object->second};
+    }
+
+    template <typename T>
+    [[nodiscard]] std::optional<T> get(std::string_view objectPath, std::string_view interface,
+                                       std::string_view property) const {
+        std::optional<MessageValue> value;
+        {
+            std::lock_guard lock(mutex);
+            if (auto object = tree.find(objectPath); object != tree.end()) {
+                if (auto iface = object->second.find(interface); iface != object->second.end()) {
+                    if (auto found = iface->second.find(property); found != iface->second.end()) {
+                        value = found->second;
+                    }
+                }
+            }
+        }
+        return value ? std::optional<T>{value->template get<T>()} : std::nullopt;
+    }
+
+  private:
+    static constexpr const char *DBUS_OBJECT_MANAGER = "org.freedesktop.DBus.ObjectManager";
+    using Changes = std::vector<std::tuple<Change, std::string, std::string>>;
+
+    // Subscribes before taking the snapshot. Signals dispatched before the snapshot is installed are queued and
+    // replayed over it in order, applying a change again leaves the same state. Signals dispatched while subscribing
+    // are already part of the snapshot, and are dropped since only some of the handlers may have seen them.
+    void start(bool trackProperties) {
+        auto &bus = connection();
+        added = bus.subscribeMessage(destination, path, DBUS_OBJECT_MANAGER, "InterfacesAdded",
+                                     [this](DBusMessage *msg) { onSignal(Change::InterfaceAdded, msg); });
+        removed = bus.subscribeMessage(destination, path, DBUS_OBJECT_MANAGER, "InterfacesRemoved",
+                                       [this](DBusMessage *msg) { onSignal(Change::InterfaceRemoved, msg); });
+        if (trackProperties) {
+            changed = bus.subscribeMessage(destination, "", DBUS_PROPS, "PropertiesChanged",
+                                           [this](DBusMessage *msg) { onSignal(Change::PropertiesChanged, msg); });
+        }
+        {
+            std::lock_guard lock(mutex);
+            subscribed = true;
+        }
+
+        auto reply = bus.sendMessage(bus.makeMessage(destination, path, DBUS_OBJECT_MANAGER, "GetManagedObjects"));
+        auto msg = MessageValue::share(reply.get());
+        DBusMessageIter iter;
+        dbus_message_iter_init(msg.get(), &iter);
+        std::map<std::string, InterfaceMap, std::less<>> snapshot;
+        forEachEntry(&iter, DBUS_TYPE_OBJECT_PATH, [&msg, &snapshot](const char *objectPath, DBusMessageIter *value) {
+            snapshot.emplace(objectPath, readInterfaces(msg, value));
+        });
+
+        std::lock_guard lock(mutex);
+        tree = std::move(snapshot);
+        byInterface.clear();
+        for (const auto &[objectPath, interfaces] : tree) {
+            for (const auto &[interface, properties] : interfaces) {
+                byInterface[interface].insert(objectPath);
+            }
+        }
+        // Nobody can have registered a callback yet, the changes are not reported.
+        Changes changes;
+        for (const auto &[change, signal] : queued) {
+            apply(change, signal, changes);
+        }
+        queued.clear();
+        primed = true;
+    }
+
+    // Calls callback(const char *key, DBusMessageIter *value) for every entry of the dictionary iter points at.
+    template <typename CALLBACK> static void forEachEntry(DBusMessageIter *iter, int keyType, CALLBACK &&callback) {
+        if (auto type = dbus_message_iter_get_arg_type(iter); type != DBUS_TYPE_ARRAY) {
+            throw parsers::ParseException(type, DBUS_TYPE_ARRAY);
+        }
+        DBusMessageIter arrayIter;
+        dbus_message_iter_recurse(iter, &arrayIter);
+        for (; dbus_message_iter_get_arg_type(&arrayIter) == DBUS_TYPE_DICT_ENTRY; dbus_message_iter_next(&arrayIter)) {
+            DBusMessageIter entryIter;
+            dbus_message_iter_recurse(&arrayIter, &entryIter);
+            if (auto type = dbus_message_iter_get_arg_type(&entryIter); type != keyType) {
+                throw parsers::ParseException(type, static_cast<char>(keyType));
+            }
+            const char *key = nullptr;
+            dbus_message_iter_get_basic(&entryIter, &key);
+            dbus_message_iter_next(&entryIter);
+            callback(key, &entryIter);
+        }
+    }
+
+    // Reads the a{sa{sv}} iter points at.
+    static InterfaceMap readInterfaces(const MessageValue::MessagePtr &msg, DBusMessageIter *iter) {
+        InterfaceMap interfaces;
+        forEachEntry(iter, DBUS_TYPE_STRING, [&msg, &interfaces](const char *interface, DBusMessageIter *value) {
+            auto &properties = interfaces[interface];
+            MessageValue::forEachProperty(msg, value, [&properties](std::string_view name, MessageValue property) {
+                properties.insert_or_assign(std::string{name}, std::move(property));
+            });
+        });
+        return interfaces;
+    }
+
+    void notify(const Changes &changes) {
+        std::vector<std::shared_ptr<const ChangeCallback>> current;
+        {
+            std::lock_guard lock(mutex);
+            current = callbacks;
+        }
+        for (const auto &[change, objectPath, interface] : changes) {
+            for (const auto &callback : current) {
+                (*callback)(change, objectPath, interface);
+            }
+        }
+    }
+
+    void onSignal(Change change, DBusMessage *signal) {
+        auto msg = MessageValue::share(signal);
+        Changes changes;
+        {
+            std::lock_guard lock(mutex);
+            if (!subscribed) {
+                return;
+            }
+            if (!primed) {
+                queued.emplace_back(change, std::move(msg));
+                return;
+            }
+            apply(change, msg, changes);
+        }
+        notify(changes);
+    }
+
+    // Applies a signal to the tree, the mutex must be held.
+    void apply(Change change, const MessageValue::MessagePtr &msg, Changes &changes) {
+        try {
+            DBusMessageIter iter;
+            if (!dbus_message_iter_init(msg.get(), &iter)) {
+                return;
+            }
+            switch (change) {
+            case Change::InterfaceAdded:
+                applyInterfacesAdded(msg, &iter, changes);
+                break;
+            case Change::InterfaceRemoved:
+                applyInterfacesRemoved(&iter, changes);
+                break;
+            case Change::PropertiesChanged:
+                applyPropertiesChanged(msg, &iter, changes);
+                break;
+            }
+        } catch (const parsers::ParseException &) {
+            // Malformed signal, keep what was applied.
+        }
+    }
+
+    void applyInterfacesAdded(const MessageValue::MessagePtr &msg, DBusMessageIter *iter, Changes &changes) {
+        auto objectPath = parsers::Parser<type::ObjectPathView>::parse(iter);
+        dbus_message_iter_next(iter);
+        auto interfaces = readInterfaces(msg, iter);
+
+        auto object = tree.find(objectPath);
+        if (object == tree.end()) {
+            object = tree.emplace(std::string{objectPath}, InterfaceMap{}).first;
+        }
+        for (auto &[interface, properties] : interfaces) {
+            byInterface[interface].insert(object->first);
+            changes.emplace_back(Change::InterfaceAdded, object->first, interface);
+            object->second.insert_or_assign(interface, std::move(properties));
+        }
+    }
+
+    void applyInterfacesRemoved(DBusMessageIter *iter, Changes &changes) {
+        auto [objectPath, interfaces] =
+            parsers::parseArguments<type::ObjectPathView, type::Array<type::StringView>>(iter);
+
+        auto object = tree.find(objectPath);
+        if (object == tree.end()) {
+            return;
+        }
+        for (auto interface : interfaces) {
+            auto iface = object->second.find(interface);
+            if (iface == object->second.end()) {
+                continue;
+            }
+            object->second.erase(iface);
+            if (auto index = byInterface.find(interface); index != byInterface.end()) {
+                index->second.erase(object->first);
+                if (index->second.empty()) {
+                    byInterface.erase(index);
+                }
+            }
+            changes.emplace_back(Change::InterfaceRemoved, object->first, interface);
+        }
+        if (object->second.empty()) {
+            tree.erase(object);
+        }
+    }
+
+    void applyPropertiesChanged(const MessageValue::MessagePtr &msg, DBusMessageIter *iter, Changes &changes) {
+        auto interface = parsers::Parser<type::StringView>::parse(iter);
+        dbus_message_iter_next(iter);
+        std::string_view objectPath = dbus_message_get_path(msg.get());
+
+        auto object = tree.find(objectPath);
+        if (object == tree.end()) {
+            return;
+        }
+        auto iface = object->second.find(interface);
+        if (iface == object->second.end()) {
+            return;
+        }
+        auto &properties = iface->second;
+        // Reported even when the invalidations turn out malformed, the values are applied by then.
+        changes.emplace_back(Change::PropertiesChanged, object->first, iface->first);
+        MessageValue::forEachProperty(msg, iter, [&properties](std::string_view name, MessageValue value) {
+            properties.insert_or_assign(std::string{name}, std::move(value));
+        });
+        dbus_message_iter_next(iter);
+        for (auto name : parsers::Parser<type::Array<type::StringView>>::parse(iter)) {
+            if (auto found = properties.find(name); found != properties.end()) {
+                properties.erase(found);
+            }
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::map<std::string, InterfaceMap, std::less<>> tree;
+    std::map<std::string, std::set<std::string, std::less<>>, std::less<>> byInterface;
+    std::vector<std::shared_ptr<const ChangeCallback>> callbacks;
+    bool subscribed{false};
+    bool primed{false};
+    std::vector<std::pair<Change, MessageValue::MessagePtr>> queued;
+    // Declared last so the handlers are removed before the state they update.
+    DBus::Subscription added;
+    DBus::Subscription removed;
+    DBus::Subscription changed;
 };
 
 } // namespace v1
@@ -0,0 +1,489 @@
+#pragma once
+
+#include "dbuspp.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace wibens::dbuspp {
+inline namespace v1 {
+
+// Adapter between libdbus connections and a main loop. Implementations only have to track watches and timeouts, the
+// dispatching of incoming messages (replies, signals, method calls) is handled here. Implementations must call
+// detachAll() from their destructor, detaching invokes the remove callbacks.
+class MainLoop {
+  public:
+    MainLoop() = default;
+    MainLoop(const MainLoop &) = delete;
+    MainLoop(MainLoop &&) = delete;
+    MainLoop &operator=(const MainLoop &) = delete;
+    MainLoop &operator=(MainLoop &&) = delete;
+    // The remove callbacks are virtual, so detaching can not happen here once the implementation is gone.
+    virtual ~MainLoop() { assert(connections.empty() && servers.empty() && "Implementations must call detachAll()"); }
+
+    // onDisconnect is called from the loop once the connection is gone and everything it received is dispatched, which
+    // makes it the place to detach and free the connection.
+    void attach(DBus &dbus, std::function<void()> onDisconnect = {}) { attach(dbus.get(), std::move(onDisconnect)); }
+    void attach(DBusConnection *conn, std::function<void()> onDisconnect = {}) {
+        if (!dbus_connection_set_watch_functions(conn, onAddWatch, onRemoveWatch, onToggleWatch, this, nullptr) ||
+            !dbus_connection_set_timeout_functions(conn, onAddTimeout, onRemoveTimeout, onToggleTimeout, this,
+                                                   nullptr)) {
+            throw std::runtime_error("Could not attach dbus connection to main loop");
+        }
+        dbus_connection_set_wakeup_main_function(conn, onWakeup, this, nullptr);
+        dbus_connection_set_dispatch_status_function(conn, onDispatchStatus, this, nullptr);
+        bool disconnected = false;
+        {
+            std::lock_guard lock(mutex);
+            connections.push_back(dbus_connection_ref(conn));
+            if (onDisconnect) {
+                disconnectHandlers[conn] = std::move(onDisconnect);
+                disconnected = !dbus_connection_get_is_connected(conn);
+            }
+        }
+        if (disconnected) {
+            queueDispatch(conn);
+        } else {
+            onDispatchStatus(conn, dbus_connection_get_dispatch_status(conn), this);
+        }
+    }
+
+    // Accepting connections on a server only needs its watches, accepted connections are attached separately.
+    void attach(DBusServer *server) {
+        if (!dbus_server_set_watch_functions(server, onAddWatch, onRemoveWatch, onToggleWatch, this, nullptr) ||
+            !dbus_server_set_timeout_functions(server, onAddTimeout, onRemoveTimeout, onToggleTimeout, this,
+                                               nullptr)) {
+            throw std::runtime_error("Could not attach dbus server to main loop");
+        }
+        std::lock_guard lock(mutex);
+        servers.push_back(dbus_server_ref(server));
+    }
+
+    // Once this returns the connection is not dispatched anymore, a dispatch running on another thread is waited for.
+    void detach(DBus &dbus) { detach(dbus.get()); }
+    void detach(DBusConnection *conn) {
+        {
+            std::unique_lock lock(mutex);
+            auto it = std::find(connections.begin(), connections.end(), conn);
+            if (it == connections.end()) {
+                return;
+            }
+            connections.erase(it);
+            dispatchQueue.erase(std::remove(dispatchQueue.begin(), dispatchQueue.end(), conn), dispatchQueue.end());
+            disconnectHandlers.erase(conn);
+            idle.wait(lock, [this, conn] { return dispatching != conn || dispatcher == std::this_thread::get_id(); });
+        }
+        dbus_connection_set_watch_functions(conn, nullptr, nullptr, nullptr, nullptr, nullptr);
+        dbus_connection_set_timeout_functions(conn, nullptr, nullptr, nullptr, nullptr, nullptr);
+        dbus_connection_set_wakeup_main_function(conn, nullptr, nullptr, nullptr);
+        dbus_connection_set_dispatch_status_function(conn, nullptr, nullptr, nullptr);
+        dbus_connection_unref(conn);
+    }
+
+    void detach(DBusServer *server) {
+        {
+            std::lock_guard lock(mutex);
+            auto it = std::find(servers.begin(), servers.end(), server);
+            if (it == servers.end()) {
+                return;
+            }
+            servers.erase(it);
+        }
+        dbus_server_set_watch_functions(server, nullptr, nullptr, nullptr, nullptr, nullptr);
+        dbus_server_set_timeout_functions(server, nullptr, nullptr, nullptr, nullptr, nullptr);
+        dbus_server_unref(server);
+    }
+
+  protected:
+    virtual bool addWatch(DBusWatch *watch) = 0;
+    virtual void removeWatch(DBusWatch *watch) = 0;
+    virtual void toggleWatch(DBusWatch *watch) = 0;
+    virtual bool addTimeout(DBusTimeout *timeout) = 0;
+    virtual void removeTimeout(DBusTimeout *timeout) = 0;
+    virtual void toggleTimeout(DBusTimeout *timeout) = 0;
+    virtual void wakeup() = 0;
+
+    // Must be called by the loop after handling watches and timeouts.
+    void dispatch() {
+        std::vector<DBusConnection *> queue;
+        {
+            std::lock_guard lock(mutex);
+            queue.swap(dispatchQueue);
+            for (auto *conn : queue) {
+                dbus_connection_ref(conn);
+            }
+        }
+        for (auto *conn : queue) {
+            dispatchOne(conn);
+            dbus_connection_unref(conn);
+        }
+    }
+
+    [[nodiscard]] bool dispatchPending() const {
+        std::lock_guard lock(mutex);
+        return !dispatchQueue.empty();
+    }
+
+    void detachAll() {
+        while (true) {
+            DBusServer *server = nullptr;
+            {
+                std::lock_guard lock(mutex);
+                if (servers.empty()) {
+                    break;
+                }
+                server = servers.back();
+            }
+            detach(server);
+        }
+        while (true) {
+            DBusConnection *conn = nullptr;
+            {
+                std::lock_guard lock(mutex);
+                if (connections.empty()) {
+                    return;
+                }
+                conn = connections.back();
+            }
+            detach(conn);
+        }
+    }
+
+  private:
+    // Marked as dispatching until the disconnect handler returned, so detaching from another thread waits for both.
+    void dispatchOne(DBusConnection *conn) {
+        {
+            std::lock_guard lock(mutex);
+            if (std::find(connections.begin(), connections.end(), conn) == connections.end()) {
+                return;
+            }
+            dispatching = conn;
+            dispatcher = std::this_thread::get_id();
+        }
+        while (dbus_connection_dispatch(conn) == DBUS_DISPATCH_DATA_REMAINS) {
+        }
+        std::function<void()> onDisconnect;
+        if (!dbus_connection_get_is_connected(conn)) {
+            std::lock_guard lock(mutex);
+            if (auto it = disconnectHandlers.find(conn); it != disconnectHandlers.end()) {
+                onDisconnect = std::move(it->second);
+                disconnectHandlers.erase(it);
+            }
+        }
+        if (onDisconnect) {
+            onDisconnect();
+        }
+        {
+            std::lock_guard lock(mutex);
+            dispatching = nullptr;
+            dispatcher = std::thread::id{};
+        }
+        idle.notify_all();
+    }
+
+    void queueDispatch(DBusConnection *conn) {
+        {
+            std::lock_guard lock(mutex);
+            if (std::find(dispatchQueue.begin(), dispatchQueue.end(), conn) != dispatchQueue.end()) {
+                return;
+            }
+            dispatchQueue.push_back(conn);
+        }
+        wakeup();
+    }
+
+    static dbus_bool_t onAddWatch(DBusWatch *watch, void *data) {
+        return static_cast<MainLoop *>(data)->addWatch(watch) ? TRUE : FALSE;
+    }
+    static void onRemoveWatch(DBusWatch *watch, void *data) { static_cast<MainLoop *>(data)->removeWatch(watch); }
+    static void onToggleWatch(DBusWatch *watch, void *data) { static_cast<MainLoop *>(data)->toggleWatch(watch); }
+    static dbus_bool_t onAddTimeout(DBusTimeout *timeout, void *data) {
+        return static_cast<MainLoop *>(data)->addTimeout(timeout) ? TRUE : FALSE;
+    }
+    static void onRemoveTimeout(DBusTimeout *timeout, void *data) {
+        static_cast<MainLoop *>(data)->removeTimeout(timeout);
+    }
+    static void onToggleTimeout(DBusTimeout *timeout, void *data) {
+        static_cast<MainLoop *>(data)->toggleTimeout(timeout);
+    }
+    static void onWakeup(void *data) { static_cast<MainLoop *>(data)->wakeup(); }
+    static void onDispatchStatus(DBusConnection *conn, DBusDispatchStatus status, void *data) {
+        if (status == DBUS_DISPATCH_DATA_REMAINS) {
+            static_cast<MainLoop *>(data)->queueDispatch(conn);
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::vector<DBusConnection *> connections;
+    std::vector<DBusServer *> servers;
+    std::vector<DBusConnection *> dispatchQueue;
+    std::unordered_map<DBusConnection *, std::function<void()>> disconnectHandlers;
+    std::condition_variable idle;
+    DBusConnection *dispatching{nullptr};
+    std::thread::id dispatcher;
+};
+
+// Standalone epoll based main loop. It can either be run on its own thread with run(), or be nested in an existing
+// reactor by polling fd() for readability and calling runOnce(0) whenever it fires or nextTimeout() expires.
+class EventLoop : public MainLoop {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    EventLoop() : epollFd(epoll_create1(EPOLL_CLOEXEC)), wakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+        if (epollFd < 0 || wakeFd < 0) {
+            closeFds();
+            throw std::runtime_error("Could not create event loop");
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wakeFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event) < 0) {
+            closeFds();
+            throw std::runtime_error("Could not create event loop");
+        }
+    }
+    EventLoop(const EventLoop &) = delete;
+    EventLoop(EventLoop &&) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+    EventLoop &operator=(EventLoop &&) = delete;
+    ~EventLoop() override {
+        detachAll();
+        closeFds();
+    }
+
+    [[nodiscard]] int fd() const { return epollFd; }
+
+    // Time until the next dbus timeout expires, or -1 when there is none.
+    [[nodiscard]] std::chrono::milliseconds nextTimeout() const {
+        std::lock_guard lock(loopMutex);
+        if (dispatchPending()) {
+            return std::chrono::milliseconds(0);
+        }
+        auto next = std::chrono::milliseconds(-1);
+        auto now = Clock::now();
+        for (const auto &[timeout, deadline] : timeouts) {
+            if (!dbus_timeout_get_enabled(timeout)) {
+                continue;
+            }
+            auto left = std::max(std::chrono::ceil<std::chrono::milliseconds>(deadline - now),
+                                 std::chrono::milliseconds(0));
+            if (next.count() < 0 || left < next) {
+                next = left;
+            }
+        }
+        return next;
+    }
+
+    // Waits at most maxWait (-1 is forever) for activity and handles it.
+    void runOnce(std::chrono::milliseconds maxWait = std::chrono::milliseconds(-1)) {
+        auto wait = nextTimeout();
+        if (wait.count() < 0 || (maxWait.count() >= 0 && maxWait < wait)) {
+            wait = maxWait;
+        }
+
+        static constexpr int MAX_EVENTS = 32;
+        std::array<epoll_event, MAX_EVENTS> events{};
+        int count = epoll_wait(epollFd, events.data(), MAX_EVENTS, static_cast<int>(wait.count()));
+        if (count < 0 && errno != EINTR) {
+            throw std::runtime_error("epoll_wait failed");
+        }
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == wakeFd) {
+                uint64_t value = 0;
+                [[maybe_unused]] auto ret = read(wakeFd, &value, sizeof(value));
+                continue;
+            }
+            handleWatches(events[i].data.fd, events[i].events);
+        }
+        handleTimeouts();
+        dispatch();
+    }
+
+    void run() {
+        stopped = false;
+        while (!stopped) {
+            runOnce();
+        }
+    }
+
+    void stop() {
+        stopped = true;
+        wakeup();
+    }
+
+  protected:
+    bool addWatch(DBusWatch *watch) override {
+        std::lock_guard lock(loopMutex);
+        int watchFd = dbus_watch_get_unix_fd(watch);
+        watches[watchFd].push_back(watch);
+        return updateFd(watchFd);
+    }
+
+    void removeWatch(DBusWatch *watch) override {
+        std::lock_guard lock(loopMutex);
+        int watchFd = dbus_watch_get_unix_fd(watch);
+        auto &list = watches[watchFd];
+        list.erase(std::remove(list.begin(), list.end(), watch), list.end());
+        updateFd(watchFd);
+        if (list.empty()) {
+            watches.erase(watchFd);
+        }
+    }
+
+    void toggleWatch(DBusWatch *watch) override {
+        std::lock_guard lock(loopMutex);
+        updateFd(dbus_watch_get_unix_fd(watch));
+    }
+
+    bool addTimeout(DBusTimeout *timeout) override {
+        {
+            std::lock_guard lock(loopMutex);
+            timeouts[timeout] = Clock::now() + std::chrono::milliseconds(dbus_timeout_get_interval(timeout));
+        }
+        wakeup();
+        return true;
+    }
+
+    void removeTimeout(DBusTimeout *timeout) override {
+        std::lock_guard lock(loopMutex);
+        timeouts.erase(timeout);
+    }
+
+    void toggleTimeout(DBusTimeout *timeout) override { addTimeout(timeout); }
+
+    void wakeup() override {
+        uint64_t value = 1;
+        [[maybe_unused]] auto ret = write(wakeFd, &value, sizeof(value));
+    }
+
+  private:
+    bool updateFd(int watchFd) {
+        uint32_t flags = 0;
+        for (auto *watch : watches[watchFd]) {
+            if (!dbus_watch_get_enabled(watch)) {
+                continue;
+            }
+            auto watchFlags = dbus_watch_get_flags(watch);
+            flags |= (watchFlags & DBUS_WATCH_READABLE) ? EPOLLIN : 0U;
+            flags |= (watchFlags & DBUS_WATCH_WRITABLE) ? EPOLLOUT : 0U;
+        }
+
+        auto registered = registeredFds.find(watchFd);
+        if (flags == 0) {
+            if (registered != registeredFds.end()) {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, watchFd, nullptr);
+                registeredFds.erase(registered);
+            }
+            return true;
+        }
+        if (registered != registeredFds.end() && registered->second == flags) {
+            return true;
+        }
+        epoll_event event{};
+        event.events = flags;
+        event.data.fd = watchFd;
+        auto op = registered == registeredFds.end() ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+        if (epoll_ctl(epollFd, op, watchFd, &event) < 0) {
+            return false;
+        }
+        registeredFds[watchFd] = flags;
+        return true;
+    }
+
+    [[nodiscard]] bool hasWatch(int watchFd, DBusWatch *watch) const {
+        auto it = watches.find(watchFd);
+        return it != watches.end() && std::find(it->second.begin(), it->second.end(), watch) != it->second.end();
+    }
+
+    void handleWatches(int watchFd, uint32_t events) {
+        static constexpr std::array<std::pair<uint32_t, unsigned int>, 4> EVENT_FLAGS = {{
+            {EPOLLIN, DBUS_WATCH_READABLE},
+            {EPOLLOUT, DBUS_WATCH_WRITABLE},
+            {EPOLLERR, DBUS_WATCH_ERROR},
+            {EPOLLHUP, DBUS_WATCH_HANGUP},
+        }};
+        unsigned int flags = 0;
+        for (const auto &[event, flag] : EVENT_FLAGS) {
+            if (events & event) {
+                flags |= flag;
+            }
+        }
+
+        std::vector<DBusWatch *> snapshot;
+        {
+            std::lock_guard lock(loopMutex);
+            if (auto it = watches.find(watchFd); it != watches.end()) {
+                snapshot = it->second;
+            }
+        }
+        for (auto *watch : snapshot) {
+            {
+                // A previous handler may have removed this watch.
+                std::lock_guard lock(loopMutex);
+                if (!hasWatch(watchFd, watch) || !dbus_watch_get_enabled(watch)) {
+                    continue;
+                }
+            }
+            dbus_watch_handle(watch, flags);
+        }
+    }
+
+    void handleTimeouts() {
+        std::vector<DBusTimeout *> expired;
+        {
+            std::lock_guard lock(loopMutex);
+            auto now = Clock::now();
+            for (auto &[timeout, deadline] : timeouts) {
+                if (dbus_timeout_get_enabled(timeout) && deadline <= now) {
+                    expired.push_back(timeout);
+                    deadline = now + std::chrono::milliseconds(dbus_timeout_get_interval(timeout));
+                }
+            }
+        }
+        for (auto *timeout : expired) {
+            {
+                std::lock_guard lock(loopMutex);
+                if (timeouts.find(timeout) == timeouts.end()) {
+                    continue;
+                }
+            }
+            dbus_timeout_handle(timeout);
+        }
+    }
+
+    void closeFds() {
+        if (wakeFd >= 0) {
+            close(wakeFd);
+        }
+        if (epollFd >= 0) {
+            close(epollFd);
+        }
+    }
+
+    int epollFd;
+    int wakeFd;
+    std::atomic<bool> stopped{false};
+    mutable std::mutex loopMutex;
+    std::unordered_map<int, std::vector<DBusWatch *>> watches;
+    std::unordered_map<int, uint32_t> registeredFds;
+    std::unordered_map<DBusTimeout *, Clock::time_point> timeouts;
+};
+
+} // namespace v1
+} // namespace wibens::dbuspp
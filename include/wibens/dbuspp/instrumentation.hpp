@@ -0,0 +1,256 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <dbus-1.0/dbus/dbus.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+namespace wibens::dbuspp {
+inline namespace v1 {
+
+// Call statistics per (destination, interface, member) of the calls made on a connection, see DBus::instrument(). Only
+// available when DBUSPP_INSTRUMENTATION is defined, otherwise none of it is compiled in. Counters and latency
+// histograms are atomics, recording a call only takes a shared lock to look up its entry.
+class Instrumentation {
+  public:
+    // Latencies are counted in power of two buckets, bucket i holds the calls that took less than 2^i nanoseconds.
+    static constexpr std::size_t BUCKETS = 40;
+
+    struct MethodSnapshot {
+        std::string destination;
+        std::string interface;
+        std::string member;
+        uint64_t calls;
+        uint64_t errors;
+        uint64_t bytesSent;
+        uint64_t bytesReceived;
+        std::array<uint64_t, BUCKETS> latency;
+
+        // Upper bound of the latency within which the given fraction of the calls completed.
+        [[nodiscard]] std::chrono::nanoseconds percentile(double fraction) const {
+            uint64_t total = 0;
+            for (auto count : latency) {
+                total += count;
+            }
+            auto target = static_cast<uint64_t>(fraction * static_cast<double>(total));
+            uint64_t seen = 0;
+            for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+                seen += latency[bucket];
+                if (seen > 0 && seen >= target) {
+                    return std::chrono::nanoseconds{int64_t{1} << bucket};
+                }
+            }
+            return std::chrono::nanoseconds{0};
+        }
+    };
+
+    // Called before a method call is sent.
+    using PreCallHook = std::function<void(DBusMessage *call)>;
+    // Called with the reply once it is taken, reply is nullptr when none was received (e.g. a timeout).
+    using PostCallHook = std::function<void(DBusMessage *call, DBusMessage *reply, std::chrono::nanoseconds latency)>;
+
+    // Bytes are the wire size of the messages, getting it copies every message. Disable when that is too expensive.
+    explicit Instrumentation(bool countBytes = true) : countBytes(countBytes) {}
+
+    void setPreCallHook(PreCallHook hook) {
+        std::atomic_store(&preCallHook, std::make_shared<const PreCallHook>(std::move(hook)));
+    }
+    void setPostCallHook(PostCallHook hook) {
+        std::atomic_store(&postCallHook, std::make_shared<const PostCallHook>(std::move(hook)));
+    }
+
+    [[nodiscard]] std::vector<MethodSnapshot> snapshot() const {
+        std::shared_lock lock(mutex);
+        std::vector<MethodSnapshot> result;
+        result.reserve(methods.size());
+        for (const auto &[key, stats] : methods) {
+            MethodSnapshot method{std::get<0>(key),
+                                  std::get<1>(key),
+                                  std::get<2>(key),
+                                  stats->calls.load(std::memory_order_relaxed),
+                                  stats->errors.load(std::memory_order_relaxed),
+                                  stats->bytesSent.load(std::memory_order_relaxed),
+                                  stats->bytesReceived.load(std::memory_order_relaxed),
+                                  {}};
+            for (std::size_t bucket = 0; bucket < BUCKETS; ++bucket) {
+                method.latency[bucket] = stats->latency[bucket].load(std::memory_order_relaxed);
+            }
+            result.push_back(std::move(method));
+        }
+        return result;
+    }
+
+  private:
+    struct Stats {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> bytesSent{0};
+        std::atomic<uint64_t> bytesReceived{0};
+        std::array<std::atomic<uint64_t>, BUCKETS> latency{};
+    };
+
+  public:
+    // A call in flight, it is recorded once by finish() or on destruction.
+    class Call {
+      public:
+        // Does nothing when owner is nullptr.
+        Call(std::shared_ptr<Instrumentation> owner, DBusMessage *msg) : owner(std::move(owner)) {
+            if (!this->owner) {
+                return;
+            }
+            this->msg = dbus_message_ref(msg);
+            stats = this->owner->statsFor(msg);
+            if (auto hook = std::atomic_load(&this->owner->preCallHook)) {
+                (*hook)(msg);
+            }
+            start = std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+        Call(const Call &) = delete;
+        Call(Call &&) = delete;
+        Call &operator=(const Call &) = delete;
+        Call &operator=(Call &&) = delete;
+        ~Call() {
+            finish(nullptr, false);
+            if (msg != nullptr) {
+                dbus_message_unref(msg);
+            }
+        }
+
+        // Takes the latency, only the first call counts.
+        void complete() {
+            int64_t expected = 0;
+            completed.compare_exchange_strong(expected, std::chrono::steady_clock::now().time_since_epoch().count());
+        }
+
+        void finish(DBusMessage *reply, bool failed) {
+            if (!owner) {
+                return;
+            }
+            complete();
+            std::chrono::nanoseconds latency{completed.load() - start};
+            stats->calls.fetch_add(1, std::memory_order_relaxed);
+            stats->latency[bucket(latency)].fetch_add(1, std::memory_order_relaxed);
+            if (failed || (reply != nullptr && dbus_message_get_type(reply) == DBUS_MESSAGE_TYPE_ERROR)) {
+                stats->errors.fetch_add(1, std::memory_order_relaxed);
+            }
+            stats->bytesSent.fetch_add(owner->messageSize(msg), std::memory_order_relaxed);
+            if (reply != nullptr) {
+                stats->bytesReceived.fetch_add(owner->messageSize(reply), std::memory_order_relaxed);
+            }
+            if (auto hook = std::atomic_load(&owner->postCallHook)) {
+                (*hook)(msg, reply, latency);
+            }
+            owner.reset();
+        }
+
+      private:
+        std::shared_ptr<Instrumentation> owner;
+        DBusMessage *msg{nullptr};
+        Stats *stats{nullptr};
+        int64_t start{0};
+        std::atomic<int64_t> completed{0};
+    };
+
+    // Keeps an asynchronous call with its pending call. The latency is taken when the reply arrives, the call is
+    // recorded when its reply is taken or when the pending call is freed.
+    static void track(DBusPendingCall *pending, std::unique_ptr<Call> call) {
+        auto *data = call.release();
+        if (!dbus_pending_call_set_data(pending, slot(), data, [](void *ptr) { delete static_cast<Call *>(ptr); })) {
+            delete data;
+            return;
+        }
+        dbus_pending_call_set_notify(
+            pending, [](DBusPendingCall *completedCall, void *) { completed(completedCall); }, nullptr, nullptr);
+        if (dbus_pending_call_get_completed(pending)) {
+            completed(pending);
+        }
+    }
+
+    // Must also be called by notify functions that replace the one installed by track().
+    static void completed(DBusPendingCall *pending) {
+        if (auto *call = static_cast<Call *>(dbus_pending_call_get_data(pending, slot()))) {
+            call->complete();
+        }
+    }
+
+    static void finished(DBusPendingCall *pending, DBusMessage *reply) {
+        if (auto *call = static_cast<Call *>(dbus_pending_call_get_data(pending, slot()))) {
+            call->finish(reply, reply == nullptr);
+            dbus_pending_call_set_data(pending, slot(), nullptr, nullptr);
+        }
+    }
+
+  private:
+    using Key = std::tuple<std::string, std::string, std::string>;
+
+    static dbus_int32_t slot() {
+        static dbus_int32_t id = [] {
+            dbus_int32_t allocated = -1;
+            if (!dbus_pending_call_allocate_data_slot(&allocated)) {
+                throw std::runtime_error("Could not allocate dbus pending call data slot");
+            }
+            return allocated;
+        }();
+        return id;
+    }
+
+    static std::size_t bucket(std::chrono::nanoseconds latency) {
+        std::size_t index = 0;
+        while (index + 1 < BUCKETS && (int64_t{1} << index) <= latency.count()) {
+            ++index;
+        }
+        return index;
+    }
+
+    static std::string_view view(const char *str) { return str ? str : ""; }
+
+    Stats *statsFor(DBusMessage *msg) {
+        auto key = std::make_tuple(view(dbus_message_get_destination(msg)), view(dbus_message_get_interface(msg)),
+                                   view(dbus_message_get_member(msg)));
+        {
+            std::shared_lock lock(mutex);
+            if (auto it = methods.find(key); it != methods.end()) {
+                return it->second.get();
+            }
+        }
+        std::unique_lock lock(mutex);
+        auto &stats = methods[Key{std::get<0>(key), std::get<1>(key), std::get<2>(key)}];
+        if (!stats) {
+            stats = std::make_unique<Stats>();
+        }
+        return stats.get();
+    }
+
+    uint64_t messageSize(DBusMessage *msg) const {
+        if (!countBytes) {
+            return 0;
+        }
+        char *data = nullptr;
+        int length = 0;
+        if (!dbus_message_marshal(msg, &data, &length)) {
+            return 0;
+        }
+        dbus_free(data);
+        return static_cast<uint64_t>(length);
+    }
+
+    bool countBytes;
+    mutable std::shared_mutex mutex;
+    std::map<Key, std::unique_ptr<Stats>, std::less<>> methods;
+    std::shared_ptr<const PreCallHook> preCallHook;
+    std::shared_ptr<const PostCallHook> postCallHook;
+};
+
+} // namespace v1
+} // namespace wibens::dbuspp
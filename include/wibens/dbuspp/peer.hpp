@@ -0,0 +1,164 @@
+#pragma once
+
+#include "dbuspp.hpp"
+#include "eventloop.hpp"
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace wibens::dbuspp {
+inline namespace v1 {
+
+// A direct connection to another process, without a bus daemon in between. Calls and proxies work as on a bus, with an
+// empty destination. There are no names and no match rules, the peer receives every signal that is sent.
+class PeerConnection : public DBus {
+  public:
+    // Connects to a PeerServer listening on address, e.g. "unix:path=/run/example.socket".
+    explicit PeerConnection(std::string_view address) : DBus(open(address), false) {}
+
+  private:
+    friend class PeerServer;
+
+    // A connection accepted by a server.
+    explicit PeerConnection(DBusConnection *accepted)
+        : DBus(ConnectionType{dbus_connection_ref(accepted), closeConnection}, false) {
+        dbus_connection_set_exit_on_disconnect(get(), FALSE);
+    }
+
+    static ConnectionType open(std::string_view address) {
+        dbus_threads_init_default();
+        DBusError err;
+        dbus_error_init(&err);
+
+        ConnectionType conn{dbus_connection_open_private(std::string{address}.c_str(), &err), closeConnection};
+        if (dbus_error_is_set(&err)) {
+            std::string what = std::string{"Could not connect to "}.append(address).append(": ") + err.message;
+            dbus_error_free(&err);
+            throw std::runtime_error(what);
+        }
+        dbus_connection_set_exit_on_disconnect(conn.get(), FALSE);
+        return conn;
+    }
+};
+
+// Accepts PeerConnections on address, e.g. "unix:path=/run/example.socket" or "unix:tmpdir=/tmp". The server and every
+// accepted connection are attached to loop, which must outlive the server. Clients are authenticated by libdbus, by
+// default only the same user is allowed.
+class PeerServer {
+  public:
+    // Called for every new connection, from the thread running the loop. Whatever it returns (e.g. the ObjectServer of
+    // the connection) is kept until the connection is dropped.
+    using ConnectionHandler = std::function<std::shared_ptr<void>(PeerConnection &connection)>;
+
+    PeerServer(MainLoop &loop, std::string_view address, ConnectionHandler handler)
+        : loop(loop), handler(std::move(handler)) {
+        dbus_threads_init_default();
+        DBusError err;
+        dbus_error_init(&err);
+
+        server = dbus_server_listen(std::string{address}.c_str(), &err);
+        if (dbus_error_is_set(&err)) {
+            std::string what = std::string{"Could not listen on "}.append(address).append(": ") + err.message;
+            dbus_error_free(&err);
+            throw std::runtime_error(what);
+        }
+        dbus_server_set_new_connection_function(server, onNewConnection, this, nullptr);
+        try {
+            loop.attach(server);
+        } catch (...) {
+            dbus_server_disconnect(server);
+            dbus_server_unref(server);
+            throw;
+        }
+    }
+    PeerServer(const PeerServer &) = delete;
+    PeerServer(PeerServer &&) = delete;
+    PeerServer &operator=(const PeerServer &) = delete;
+    PeerServer &operator=(PeerServer &&) = delete;
+    ~PeerServer() {
+        dbus_server_disconnect(server);
+        loop.detach(server);
+        // Detaching waits for the loop to finish dispatching a client, which may be about to drop it under the mutex.
+        std::vector<Client> remaining;
+        {
+            std::lock_guard lock(mutex);
+            remaining.swap(clients);
+        }
+        for (auto &client : remaining) {
+            drop(client);
+        }
+        dbus_server_unref(server);
+    }
+
+    // The address clients connect to, with the actual path when listening on a tmpdir.
+    [[nodiscard]] std::string address() const {
+        char *str = dbus_server_get_address(server);
+        std::string result{str};
+        dbus_free(str);
+        return result;
+    }
+
+    // Number of connected clients.
+    [[nodiscard]] std::size_t size() const {
+        std::lock_guard lock(mutex);
+        return static_cast<std::size_t>(std::count_if(clients.begin(), clients.end(), [](const Client &client) {
+            return dbus_connection_get_is_connected(client.conn->get());
+        }));
+    }
+
+  private:
+    struct Client {
+        std::unique_ptr<PeerConnection> conn;
+        std::shared_ptr<void> state;
+    };
+
+    static void onNewConnection(DBusServer *, DBusConnection *accepted, void *data) {
+        static_cast<PeerServer *>(data)->accept(accepted);
+    }
+
+    void accept(DBusConnection *accepted) {
+        std::unique_ptr<PeerConnection> conn{new PeerConnection(accepted)};
+        auto state = handler ? handler(*conn) : nullptr;
+        // Called by the loop once the client is gone and everything it sent is dispatched, which happens after this
+        // returns since accepting runs on the loop as well.
+        loop.attach(*conn, [this, key = conn->get()] { reap(key); });
+
+        std::lock_guard lock(mutex);
+        clients.push_back({std::move(conn), std::move(state)});
+    }
+
+    void reap(DBusConnection *conn) {
+        Client client;
+        {
+            std::lock_guard lock(mutex);
+            auto it = std::find_if(clients.begin(), clients.end(),
+                                   [conn](const Client &candidate) { return candidate.conn->get() == conn; });
+            if (it == clients.end()) {
+                return;
+            }
+            client = std::move(*it);
+            clients.erase(it);
+        }
+        drop(client);
+    }
+
+    void drop(Client &client) {
+        loop.detach(*client.conn);
+        client.state.reset();
+        client.conn.reset();
+    }
+
+    MainLoop &loop;
+    ConnectionHandler handler;
+    DBusServer *server{nullptr};
+    mutable std::mutex mutex;
+    std::vector<Client> clients;
+};
+
+} // namespace v1
+} // namespace wibens::dbuspp
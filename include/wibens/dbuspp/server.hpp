@@ -0,0 +1,595 @@
+#pragma once
+
+#include "dbuspp.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace wibens::dbuspp {
+inline namespace v1 {
+
+// FNV-1a, usable at compile time so fixed names can be hashed up front.
+constexpr uint64_t fnv1a(std::string_view str, uint64_t hash = 0xcbf29ce484222325ULL) {
+    for (char chr : str) {
+        hash ^= static_cast<uint8_t>(chr);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Maps (interface, member) to a value. The table is built once for a fixed set of keys by searching a seed for which
+// every key hashes to its own slot, a lookup is then a single hash and one comparison of the key found in that slot.
+template <typename VALUE> class PerfectHashTable {
+  public:
+    struct Entry {
+        std::string interface;
+        std::string member;
+        VALUE value;
+    };
+
+    PerfectHashTable() = default;
+    explicit PerfectHashTable(std::vector<Entry> keyValues) : entries(std::move(keyValues)) { build(); }
+
+    [[nodiscard]] const VALUE *find(std::string_view interface, std::string_view member) const {
+        if (slots.empty()) {
+            return nullptr;
+        }
+        auto slot = slots[slotOf(interface, member, seed, mask)];
+        if (slot == 0) {
+            return nullptr;
+        }
+        const auto &entry = entries[slot - 1];
+        return entry.interface == interface && entry.member == member ? &entry.value : nullptr;
+    }
+
+    // Method calls do not have to name the interface, those are looked up on the member only.
+    [[nodiscard]] const VALUE *findMember(std::string_view member) const {
+        auto found = std::find_if(entries.begin(), entries.end(),
+                                  [member](const Entry &entry) { return entry.member == member; });
+        return found == entries.end() ? nullptr : &found->value;
+    }
+
+    [[nodiscard]] const std::vector<Entry> &all() const { return entries; }
+
+  private:
+    static constexpr uint64_t SEED_ATTEMPTS = 64;
+
+    static std::size_t slotOf(std::string_view interface, std::string_view member, uint64_t seed, std::size_t mask) {
+        // '/' can not occur in either name, so it separates them unambiguously.
+        auto hash = fnv1a(member, fnv1a("/", fnv1a(interface, 0xcbf29ce484222325ULL ^ seed)));
+        return static_cast<std::size_t>(hash ^ (hash >> 32)) & mask;
+    }
+
+    void build() {
+        std::vector<std::pair<std::string_view, std::string_view>> keys;
+        keys.reserve(entries.size());
+        for (const auto &entry : entries) {
+            keys.emplace_back(entry.interface, entry.member);
+        }
+        std::sort(keys.begin(), keys.end());
+        if (auto duplicate = std::adjacent_find(keys.begin(), keys.end()); duplicate != keys.end()) {
+            throw std::runtime_error("Duplicate member " + std::string{duplicate->first} + "." +
+                                     std::string{duplicate->second});
+        }
+
+        std::size_t size = 1;
+        while (size < entries.size() * 2) {
+            size <<= 1;
+        }
+        for (;; size <<= 1) {
+            for (seed = 0; seed < SEED_ATTEMPTS; ++seed) {
+                if (tryBuild(size)) {
+                    return;
+                }
+            }
+        }
+    }
+
+    bool tryBuild(std::size_t size) {
+        mask = size - 1;
+        slots.assign(size, 0);
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            auto &slot = slots[slotOf(entries[i].interface, entries[i].member, seed, mask)];
+            if (slot != 0) {
+                return false;
+            }
+            slot = static_cast<uint32_t>(i + 1);
+        }
+        return true;
+    }
+
+    std::vector<Entry> entries;
+    // Index into entries plus one, zero marks an empty slot.
+    std::vector<uint32_t> slots;
+    uint64_t seed{0};
+    std::size_t mask{0};
+};
+
+// Exports C++ objects on a connection. Arguments and replies are (un)marshalled with the same parsers as used for
+// calls, org.freedesktop.DBus.Properties and Introspectable are implemented for every object. Handlers are called on
+// the thread that dispatches the connection, e.g. from an EventLoop.
+class ObjectServer {
+  public:
+    // Throw from a handler to reply with a specific error, other exceptions are replied as Error.Failed.
+    class Error : public std::runtime_error {
+      public:
+        Error(std::string name, const std::string &message) : std::runtime_error(message), errorName(std::move(name)) {}
+
+        [[nodiscard]] const char *name() const { return errorName.c_str(); }
+
+      private:
+        std::string errorName;
+    };
+
+    // Gets the method call, returns the reply.
+    using MethodHandler = std::function<DBus::Message(DBusMessage *)>;
+
+    struct Method {
+        std::vector<std::string> in;
+        std::vector<std::string> out;
+        std::vector<std::string> argNames;
+        MethodHandler handler;
+    };
+
+    struct Property {
+        std::string signature;
+        // Appends the value as variant.
+        std::function<void(DBusMessageIter *)> get;
+        // Reads the value from the variant iter points at, empty for read-only properties.
+        std::function<void(DBusMessageIter *)> set;
+    };
+
+    struct Signal {
+        std::vector<std::string> args;
+        std::vector<std::string> argNames;
+    };
+
+    // The members of one interface of an exported object.
+    class Interface {
+      public:
+        explicit Interface(std::string name) : name(std::move(name)) {}
+
+        // handler(ARGS...) is called with the parsed arguments. It may return nothing, a value or a std::tuple of
+        // values that are sent as separate reply arguments (return std::tuple<type::Struct<...>> for a struct).
+        // argNames name the in arguments followed by the out arguments, they are only used for introspection.
+        template <typename HANDLER>
+        Interface &method(std::string member, HANDLER &&handler, std::vector<std::string> argNames = {}) {
+            using Traits = Callable<std::decay_t<HANDLER>>;
+            methods.emplace_back(std::move(member),
+                                 makeMethod<typename Traits::Return>(std::forward<HANDLER>(handler),
+                                                                     static_cast<typename Traits::Args *>(nullptr),
+                                                                     std::move(argNames)));
+            return *this;
+        }
+
+        // A read-only property, the type is the one returned by getter().
+        template <typename GETTER> Interface &property(std::string member, GETTER &&getter) {
+            properties.emplace_back(std::move(member), makeProperty(std::forward<GETTER>(getter)));
+            return *this;
+        }
+
+        // A read-write property, setter(T) is called with the new value.
+        template <typename GETTER, typename SETTER>
+        Interface &property(std::string member, GETTER &&getter, SETTER &&setter) {
+            using T = std::decay_t<std::invoke_result_t<GETTER &>>;
+            auto property = makeProperty(std::forward<GETTER>(getter));
+            property.set = [setter = std::forward<SETTER>(setter)](DBusMessageIter *iter) mutable {
+                setter(std::get<T>(parsers::Parser<type::Variant<T>>::parse(iter)));
+            };
+            properties.emplace_back(std::move(member), std::move(property));
+            return *this;
+        }
+
+        // Declares a signal for introspection, it is sent with ObjectServer::emit().
+        template <typename... ARGS> Interface &signal(std::string member, std::vector<std::string> argNames = {}) {
+            signals.emplace_back(std::move(member),
+                                 Signal{{std::string{parsers::signatureOf<ARGS>}...}, std::move(argNames)});
+            return *this;
+        }
+
+      private:
+        friend class ObjectServer;
+
+        template <typename RET, typename... ARGS, typename HANDLER>
+        static Method makeMethod(HANDLER &&handler, std::tuple<ARGS...> *, std::vector<std::string> argNames) {
+            using Out = std::conditional_t<std::is_void_v<RET>, std::tuple<>,
+                                           std::conditional_t<IsTuple<RET>::value, RET, std::tuple<RET>>>;
+            Method method{{std::string{parsers::signatureOf<ARGS>}...}, signatures(static_cast<Out *>(nullptr)),
+                          std::move(argNames), nullptr};
+            method.handler = [handler = std::forward<HANDLER>(handler)](DBusMessage *call) mutable {
+                auto args = parseCall<ARGS...>(call);
+                DBus::Message reply{dbus_message_new_method_return(call)};
+                if constexpr (std::is_void_v<RET>) {
+                    std::apply(handler, std::move(args));
+                } else if constexpr (IsTuple<RET>::value) {
+                    std::apply([&reply](const auto &...values) { reply.addArguments(values...); },
+                               std::apply(handler, std::move(args)));
+                } else {
+                    reply.addArguments(std::apply(handler, std::move(args)));
+                }
+                return reply;
+            };
+            return method;
+        }
+
+        template <typename GETTER> static Property makeProperty(GETTER &&getter) {
+            using T = std::decay_t<std::invoke_result_t<GETTER &>>;
+            return {std::string{parsers::signatureOf<T>},
+                    [getter = std::forward<GETTER>(getter)](DBusMessageIter *iter) mutable {
+                        const T value = getter();
+                        parsers::appendContainer(
+                            iter, DBUS_TYPE_VARIANT, parsers::Parser<T>::signature.c_str(),
+                            [&value](DBusMessageIter *subIter) { parsers::Parser<T>::append(subIter, value); });
+                    },
+                    nullptr};
+        }
+
+        template <typename... T> static std::vector<std::string> signatures(std::tuple<T...> *) {
+            return {std::string{parsers::signatureOf<T>}...};
+        }
+
+        std::string name;
+        std::vector<std::pair<std::string, Method>> methods;
+        std::vector<std::pair<std::string, Property>> properties;
+        std::vector<std::pair<std::string, Signal>> signals;
+    };
+
+    explicit ObjectServer(DBus &dbus) : conn(dbus_connection_ref(dbus.get())) {}
+    ObjectServer(const ObjectServer &) = delete;
+    ObjectServer(ObjectServer &&) = delete;
+    ObjectServer &operator=(const ObjectServer &) = delete;
+    ObjectServer &operator=(ObjectServer &&) = delete;
+    ~ObjectServer() {
+        for (const auto &[path, object] : objects) {
+            dbus_connection_unregister_object_path(conn, path.c_str());
+        }
+        dbus_connection_unref(conn);
+    }
+
+    // Exports an object implementing the given interfaces on path. Its dispatch table is built here, once.
+    void add(std::string path, std::vector<Interface> interfaces) {
+        auto object = std::make_unique<Object>(conn, path, std::move(interfaces));
+        static constexpr DBusObjectPathVTable VTABLE{nullptr, onMessage, nullptr, nullptr, nullptr, nullptr};
+        DBusError err;
+        dbus_error_init(&err);
+        if (!dbus_connection_try_register_object_path(conn, path.c_str(), &VTABLE, object.get(), &err)) {
+            std::string what = std::string{"Could not register object: "} + (err.message ? err.message : path);
+            dbus_error_free(&err);
+            throw std::runtime_error(what);
+        }
+        std::lock_guard lock(mutex);
+        objects.emplace(std::move(path), std::move(object));
+    }
+
+    // Must not be called while a method call on the object is being handled.
+    void remove(std::string_view path) {
+        std::lock_guard lock(mutex);
+        auto it = objects.find(path);
+        if (it == objects.end()) {
+            return;
+        }
+        dbus_connection_unregister_object_path(conn, it->first.c_str());
+        objects.erase(it);
+    }
+
+    template <typename... ARGS>
+    void emit(std::string_view path, std::string_view interface, std::string_view member, const ARGS &...args) {
+        DBus::Message signal{dbus_message_new_signal(std::string{path}.c_str(), std::string{interface}.c_str(),
+                                                     std::string{member}.c_str())};
+        if constexpr (sizeof...(ARGS) > 0) {
+            signal.addArguments(args...);
+        }
+        send(conn, signal);
+    }
+
+    // Emits PropertiesChanged with the current values of the given properties.
+    void propertiesChanged(std::string_view path, std::string_view interface, const std::vector<std::string> &names) {
+        std::optional<DBus::Message> signal;
+        {
+            std::lock_guard lock(mutex);
+            auto it = objects.find(path);
+            if (it == objects.end()) {
+                throw std::runtime_error("No object exported on " + std::string{path});
+            }
+            signal.emplace(it->second->propertiesChanged(interface, names));
+        }
+        send(conn, *signal);
+    }
+
+  private:
+    template <typename F> struct Callable : Callable<decltype(&F::operator())> {};
+    template <typename R, typename... A> struct Callable<R (*)(A...)> {
+        using Return = R;
+        using Args = std::tuple<std::decay_t<A>...>;
+    };
+    template <typename C, typename R, typename... A> struct Callable<R (C::*)(A...)> : Callable<R (*)(A...)> {};
+    template <typename C, typename R, typename... A> struct Callable<R (C::*)(A...) const> : Callable<R (*)(A...)> {};
+
+    template <typename T> struct IsTuple : std::false_type {};
+    template <typename... T> struct IsTuple<std::tuple<T...>> : std::true_type {};
+
+    // The signature is compared once, after which the arguments are read without checking every type.
+    template <typename... ARGS> static std::tuple<ARGS...> parseCall(DBusMessage *call) {
+        using Args = parsers::Arguments<ARGS...>;
+        DBusMessageIter iter;
+        dbus_message_iter_init(call, &iter);
+        if constexpr (Args::exactSignature) {
+            std::string_view received = dbus_message_get_signature(call);
+            if (received != Args::signature.view()) {
+                throw parsers::ParseException("Expected signature " + std::string{Args::signature.view()} +
+                                              ", received " + std::string{received});
+            }
+            return Args::template parse<false>(&iter);
+        } else {
+            return Args::parse(&iter);
+        }
+    }
+
+    static void send(DBusConnection *conn, const DBus::Message &msg) {
+        if (!dbus_connection_send(conn, msg.get(), nullptr)) {
+            throw std::runtime_error("Could not send dbus message");
+        }
+    }
+
+    class Object {
+      public:
+        Object(DBusConnection *conn, std::string path, std::vector<Interface> interfaces)
+            : conn(conn), path(std::move(path)) {
+            std::vector<MethodTable::Entry> methodEntries;
+            std::vector<PropertyTable::Entry> propertyEntries;
+            for (auto &interface : interfaces) {
+                introspection += introspect(interface);
+                for (auto &[member, method] : interface.methods) {
+                    methodEntries.push_back({interface.name, member, std::move(method)});
+                }
+                for (auto &[member, property] : interface.properties) {
+                    propertyEntries.push_back({interface.name, member, std::move(property)});
+                }
+            }
+            addStandardMethods(methodEntries);
+            methods = MethodTable{std::move(methodEntries)};
+            properties = PropertyTable{std::move(propertyEntries)};
+        }
+
+        DBusHandlerResult handle(DBusMessage *call) {
+            auto interface = view(dbus_message_get_interface(call));
+            auto member = view(dbus_message_get_member(call));
+            const auto *method = interface.empty() ? methods.findMember(member) : methods.find(interface, member);
+            if (method == nullptr) {
+                return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+            }
+            DBusMessage *reply = invoke(*method, call);
+            if (reply == nullptr) {
+                return DBUS_HANDLER_RESULT_NEED_MEMORY;
+            }
+            if (!dbus_message_get_no_reply(call)) {
+                dbus_connection_send(conn, reply, nullptr);
+            }
+            dbus_message_unref(reply);
+            return DBUS_HANDLER_RESULT_HANDLED;
+        }
+
+        DBus::Message propertiesChanged(std::string_view interface, const std::vector<std::string> &names) {
+            DBus::Message signal{dbus_message_new_signal(path.c_str(), DBUS_PROPS, "PropertiesChanged")};
+            signal.addArgument(interface);
+            DBusMessageIter iter;
+            dbus_message_iter_init_append(signal.get(), &iter);
+            appendProperties(&iter, interface, [&names](std::string_view name) {
+                return std::find(names.begin(), names.end(), name) != names.end();
+            });
+            signal.addArgument(type::Array<type::String>{});
+            return signal;
+        }
+
+      private:
+        using MethodTable = PerfectHashTable<Method>;
+        using PropertyTable = PerfectHashTable<Property>;
+
+        static std::string_view view(const char *str) { return str ? str : ""; }
+
+        static DBusMessage *invoke(const Method &method, DBusMessage *call) {
+            try {
+                auto reply = method.handler(call);
+                return dbus_message_ref(reply.get());
+            } catch (const Error &e) {
+                return dbus_message_new_error(call, e.name(), e.what());
+            } catch (const parsers::ParseException &e) {
+                return dbus_message_new_error(call, DBUS_ERROR_INVALID_ARGS, e.what());
+            } catch (const std::exception &e) {
+                return dbus_message_new_error(call, DBUS_ERROR_FAILED, e.what());
+            }
+        }
+
+        const Property &findProperty(std::string_view interface, std::string_view name) const {
+            const auto *property = properties.find(interface, name);
+            if (property == nullptr) {
+                throw Error(DBUS_ERROR_UNKNOWN_PROPERTY,
+                            "Unknown property " + std::string{interface} + "." + std::string{name});
+            }
+            return *property;
+        }
+
+        // Appends the a{sv} of the properties of interface for which filter(name) holds.
+        template <typename FILTER>
+        void appendProperties(DBusMessageIter *iter, std::string_view interface, FILTER &&filter) const {
+            parsers::appendContainer(iter, DBUS_TYPE_ARRAY, "{sv}", [&](DBusMessageIter *arrayIter) {
+                for (const auto &entry : properties.all()) {
+                    if (entry.interface != interface || !filter(std::string_view{entry.member})) {
+                        continue;
+                    }
+                    parsers::appendContainer(arrayIter, DBUS_TYPE_DICT_ENTRY, nullptr, [&entry](DBusMessageIter *sub) {
+                        parsers::Parser<type::String>::append(sub, entry.member);
+                        entry.value.get(sub);
+                    });
+                }
+            });
+        }
+
+        void addStandardMethods(std::vector<MethodTable::Entry> &entries) {
+            auto add = [&entries](const char *interface, const char *member, Method method) {
+                entries.push_back({interface, member, std::move(method)});
+            };
+            add(DBUS_PROPS, "Get",
+                {{"s", "s"}, {"v"}, {}, [this](DBusMessage *call) { return getProperty(call); }});
+            add(DBUS_PROPS, "GetAll",
+                {{"s"}, {"a{sv}"}, {}, [this](DBusMessage *call) { return getAllProperties(call); }});
+            add(DBUS_PROPS, "Set", {{"s", "s", "v"}, {}, {}, [this](DBusMessage *call) { return setProperty(call); }});
+            add("org.freedesktop.DBus.Introspectable", "Introspect", {{}, {"s"}, {}, [this](DBusMessage *call) {
+                    DBus::Message reply{dbus_message_new_method_return(call)};
+                    reply.addArgument(introspect());
+                    return reply;
+                }});
+        }
+
+        DBus::Message getProperty(DBusMessage *call) const {
+            auto [interface, name] = parseCall<std::string_view, std::string_view>(call);
+            const auto &property = findProperty(interface, name);
+            DBus::Message reply{dbus_message_new_method_return(call)};
+            DBusMessageIter iter;
+            dbus_message_iter_init_append(reply.get(), &iter);
+            property.get(&iter);
+            return reply;
+        }
+
+        DBus::Message getAllProperties(DBusMessage *call) const {
+            auto [interface] = parseCall<std::string_view>(call);
+            DBus::Message reply{dbus_message_new_method_return(call)};
+            DBusMessageIter iter;
+            dbus_message_iter_init_append(reply.get(), &iter);
+            appendProperties(&iter, interface, [](std::string_view) { return true; });
+            return reply;
+        }
+
+        // Emits PropertiesChanged once the new value is set.
+        DBus::Message setProperty(DBusMessage *call) {
+            if (std::string_view{dbus_message_get_signature(call)} != "ssv") {
+                throw parsers::ParseException("Expected signature ssv, received " +
+                                              std::string{dbus_message_get_signature(call)});
+            }
+            DBusMessageIter iter;
+            dbus_message_iter_init(call, &iter);
+            auto [interface, name] = parsers::Arguments<std::string_view, std::string_view>::parse<false>(&iter);
+            const auto &property = findProperty(interface, name);
+            if (!property.set) {
+                throw Error(DBUS_ERROR_PROPERTY_READ_ONLY,
+                            "Property " + std::string{interface} + "." + std::string{name} + " is read-only");
+            }
+            property.set(&iter);
+            send(conn, propertiesChanged(interface, {std::string{name}}));
+            return DBus::Message{dbus_message_new_method_return(call)};
+        }
+
+        static void appendArgs(std::string &xml, const std::vector<std::string> &types,
+                               const std::vector<std::string> &names, std::size_t firstName, const char *direction) {
+            for (std::size_t i = 0; i < types.size(); ++i) {
+                xml += "      <arg";
+                if (firstName + i < names.size()) {
+                    xml += " name=\"" + names[firstName + i] + "\"";
+                }
+                xml += " type=\"" + types[i] + "\"";
+                if (direction != nullptr) {
+                    xml += std::string{" direction=\""} + direction + "\"";
+                }
+                xml += "/>\n";
+            }
+        }
+
+        static std::string introspect(const Interface &interface) {
+            std::string xml = "  <interface name=\"" + interface.name + "\">\n";
+            for (const auto &[member, method] : interface.methods) {
+                xml += "    <method name=\"" + member + "\">\n";
+                appendArgs(xml, method.in, method.argNames, 0, "in");
+                appendArgs(xml, method.out, method.argNames, method.in.size(), "out");
+                xml += "    </method>\n";
+            }
+            for (const auto &[member, signal] : interface.signals) {
+                xml += "    <signal name=\"" + member + "\">\n";
+                appendArgs(xml, signal.args, signal.argNames, 0, nullptr);
+                xml += "    </signal>\n";
+            }
+            for (const auto &[member, property] : interface.properties) {
+                xml += "    <property name=\"" + member + "\" type=\"" + property.signature + "\" access=\"" +
+                       (property.set ? "readwrite" : "read") + "\"/>\n";
+            }
+            return xml + "  </interface>\n";
+        }
+
+        std::string introspect() const {
+            std::string xml = DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE "<node>\n";
+            xml.append(STANDARD_INTERFACES).append(introspection);
+            char **children = nullptr;
+            if (dbus_connection_list_registered(conn, path.c_str(), &children)) {
+                for (char **child = children; *child != nullptr; ++child) {
+                    xml += std::string{"  <node name=\""} + *child + "\"/>\n";
+                }
+                dbus_free_string_array(children);
+            }
+            return xml + "</node>\n";
+        }
+
+        static constexpr const char *STANDARD_INTERFACES =
+            "  <interface name=\"org.freedesktop.DBus.Introspectable\">\n"
+            "    <method name=\"Introspect\">\n"
+            "      <arg name=\"xml_data\" type=\"s\" direction=\"out\"/>\n"
+            "    </method>\n"
+            "  </interface>\n"
+            "  <interface name=\"org.freedesktop.DBus.Peer\">\n"
+            "    <method name=\"Ping\"/>\n"
+            "    <method name=\"GetMachineId\">\n"
+            "      <arg name=\"machine_uuid\" type=\"s\" direction=\"out\"/>\n"
+            "    </method>\n"
+            "  </interface>\n"
+            "  <interface name=\"org.freedesktop.DBus.Properties\">\n"
+            "    <method name=\"Get\">\n"
+            "      <arg name=\"interface_name\" type=\"s\" direction=\"in\"/>\n"
+            "      <arg name=\"property_name\" type=\"s\" direction=\"in\"/>\n"
+            "      <arg name=\"value\" type=\"v\" direction=\"out\"/>\n"
+            "    </method>\n"
+            "    <method name=\"GetAll\">\n"
+            "      <arg name=\"interface_name\" type=\"s\" direction=\"in\"/>\n"
+            "      <arg name=\"props\" type=\"a{sv}\" direction=\"out\"/>\n"
+            "    </method>\n"
+            "    <method name=\"Set\">\n"
+            "      <arg name=\"interface_name\" type=\"s\" direction=\"in\"/>\n"
+            "      <arg name=\"property_name\" type=\"s\" direction=\"in\"/>\n"
+            "      <arg name=\"value\" type=\"v\" direction=\"in\"/>\n"
+            "    </method>\n"
+            "    <signal name=\"PropertiesChanged\">\n"
+            "      <arg name=\"interface_name\" type=\"s\"/>\n"
+            "      <arg name=\"changed_properties\" type=\"a{sv}\"/>\n"
+            "      <arg name=\"invalidated_properties\" type=\"as\"/>\n"
+            "    </signal>\n"
+            "  </interface>\n";
+
+        DBusConnection *conn;
+        std::string path;
+        std::string introspection;
+        MethodTable methods;
+        PropertyTable properties;
+    };
+
+    static DBusHandlerResult onMessage(DBusConnection *, DBusMessage *msg, void *data) {
+        if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL) {
+            return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+        }
+        return static_cast<Object *>(data)->handle(msg);
+    }
+
+    DBusConnection *conn;
+    std::mutex mutex;
+    std::map<std::string, std::unique_ptr<Object>, std::less<>> objects;
+};
+
+} // namespace v1
+} // namespace wibens::dbuspp
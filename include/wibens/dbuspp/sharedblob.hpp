@@ -0,0 +1,130 @@
+#pragma once
+
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace wibens::dbuspp {
+inline namespace v1 {
+namespace type {
+
+// A read-only block of memory that is sent as a sealed memfd (signature 'h') instead of being marshalled as 'ay'. The
+// daemon only passes the descriptor along, the receiver maps the same pages. Both ends of the connection must support
+// fd passing, see dbus_connection_can_send_type(connection, DBUS_TYPE_UNIX_FD).
+class SharedBlob {
+  public:
+    SharedBlob() = default;
+    SharedBlob(const void *data, std::size_t size)
+        : SharedBlob(create(size, [data](uint8_t *target, std::size_t count) { std::memcpy(target, data, count); })) {}
+    SharedBlob(const SharedBlob &) = delete;
+    SharedBlob(SharedBlob &&other) noexcept
+        : file(std::move(other.file)), mapping(std::exchange(other.mapping, nullptr)),
+          length(std::exchange(other.length, 0)) {}
+    SharedBlob &operator=(const SharedBlob &) = delete;
+    SharedBlob &operator=(SharedBlob &&other) noexcept {
+        if (this != &other) {
+            unmap();
+            file = std::move(other.file);
+            mapping = std::exchange(other.mapping, nullptr);
+            length = std::exchange(other.length, 0);
+        }
+        return *this;
+    }
+    ~SharedBlob() { unmap(); }
+
+    // Fills a new blob of size bytes in place, writer is called as writer(uint8_t *data, std::size_t size).
+    template <typename WRITER> static SharedBlob create(std::size_t size, WRITER &&writer) {
+        UnixFileDescriptor fd{memfd_create("dbuspp-blob", MFD_CLOEXEC | MFD_ALLOW_SEALING)};
+        if (!fd) {
+            throw std::runtime_error("Could not create memfd");
+        }
+        if (ftruncate(fd.get(), static_cast<off_t>(size)) != 0) {
+            throw std::runtime_error("Could not resize memfd");
+        }
+        if (size > 0) {
+            // The writable mapping must be gone before F_SEAL_WRITE can be added.
+            void *target = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+            if (target == MAP_FAILED) {
+                throw std::runtime_error("Could not map memfd");
+            }
+            try {
+                writer(static_cast<uint8_t *>(target), size);
+            } catch (...) {
+                munmap(target, size);
+                throw;
+            }
+            munmap(target, size);
+        }
+        if (fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+            throw std::runtime_error("Could not seal memfd");
+        }
+        return map(std::move(fd));
+    }
+
+    // Maps a received descriptor. Only sealed memfds are accepted, anything else could change or shrink under the
+    // mapping.
+    static SharedBlob map(UnixFileDescriptor fd) {
+        int seals = fcntl(fd.get(), F_GET_SEALS);
+        if (seals < 0 || (seals & (F_SEAL_WRITE | F_SEAL_SHRINK)) != (F_SEAL_WRITE | F_SEAL_SHRINK)) {
+            throw std::runtime_error("Shared blob is not a sealed memfd");
+        }
+        struct stat info {};
+        if (fstat(fd.get(), &info) != 0) {
+            throw std::runtime_error("Could not get shared blob size");
+        }
+        SharedBlob blob;
+        blob.length = static_cast<std::size_t>(info.st_size);
+        if (blob.length > 0) {
+            void *data = mmap(nullptr, blob.length, PROT_READ, MAP_SHARED, fd.get(), 0);
+            if (data == MAP_FAILED) {
+                throw std::runtime_error("Could not map shared blob");
+            }
+            blob.mapping = data;
+        }
+        blob.file = std::move(fd);
+        return blob;
+    }
+
+    [[nodiscard]] const uint8_t *data() const { return static_cast<const uint8_t *>(mapping); }
+    [[nodiscard]] std::size_t size() const { return length; }
+    [[nodiscard]] const uint8_t *begin() const { return data(); }
+    [[nodiscard]] const uint8_t *end() const { return data() + length; }
+    [[nodiscard]] ArrayView<U8> view() const { return {data(), length}; }
+    [[nodiscard]] const UnixFileDescriptor &fd() const { return file; }
+
+  private:
+    void unmap() {
+        if (mapping != nullptr) {
+            munmap(mapping, length);
+            mapping = nullptr;
+        }
+    }
+
+    UnixFileDescriptor file;
+    void *mapping{nullptr};
+    std::size_t length{0};
+};
+
+} // namespace type
+
+namespace parsers {
+
+template <> struct Parser<type::SharedBlob> : ParserHelper<type::SharedBlob, DBUS_TYPE_UNIX_FD> {
+    template <bool CHECKED = true> static type::SharedBlob parse(DBusMessageIter *iter) {
+        return type::SharedBlob::map(Parser<type::UnixFileDescriptor>::parse<CHECKED>(iter));
+    }
+    static void append(DBusMessageIter *iter, const type::SharedBlob &val) {
+        Parser<type::UnixFileDescriptor>::append(iter, val.fd());
+    }
+};
+
+} // namespace parsers
+} // namespace v1
+} // namespace wibens::dbuspp
@@ -1,12 +1,25 @@
 #pragma once
 
-// #include <any>
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <dbus-1.0/dbus/dbus.h>
+#include <fcntl.h>
+#include <functional>
+#include <initializer_list>
 #include <map>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -30,8 +43,52 @@ using U64 = uint64_t;
 using Double = double;
 using String = std::string;
 
-struct UnixFileDescriptor {
-    uint32_t fd;
+// Owns a file descriptor and closes it on destruction. Received descriptors are duplicates owned by the receiver,
+// appending one to a message duplicates it again so the original stays owned here.
+class UnixFileDescriptor {
+  public:
+    UnixFileDescriptor() = default;
+    explicit UnixFileDescriptor(int fd) : fd(fd) {}
+    UnixFileDescriptor(const UnixFileDescriptor &) = delete;
+    UnixFileDescriptor(UnixFileDescriptor &&other) noexcept : fd(other.release()) {}
+    UnixFileDescriptor &operator=(const UnixFileDescriptor &) = delete;
+    UnixFileDescriptor &operator=(UnixFileDescriptor &&other) noexcept {
+        if (this != &other) {
+            reset(other.release());
+        }
+        return *this;
+    }
+    ~UnixFileDescriptor() { reset(); }
+
+    [[nodiscard]] int get() const { return fd; }
+    explicit operator bool() const { return fd >= 0; }
+
+    // Gives up ownership without closing.
+    int release() {
+        int released = fd;
+        fd = -1;
+        return released;
+    }
+
+    void reset(int newFd = -1) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        fd = newFd;
+    }
+
+    // A new descriptor for the same file.
+    [[nodiscard]] UnixFileDescriptor duplicate() const { return duplicate(fd); }
+    static UnixFileDescriptor duplicate(int fd) {
+        int duplicated = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (duplicated < 0) {
+            throw std::runtime_error("Could not duplicate file descriptor");
+        }
+        return UnixFileDescriptor{duplicated};
+    }
+
+  private:
+    int fd{-1};
 };
 class ObjectPath : public std::string {
   public:
@@ -42,11 +99,97 @@ class Signature : public std::string {
     using std::string::string;
 };
 
+// Views point into the received message and are only valid as long as the DBus::Reply they were parsed from.
+using StringView = std::string_view;
+class ObjectPathView : public std::string_view {
+  public:
+    using std::string_view::string_view;
+};
+class SignatureView : public std::string_view {
+  public:
+    using std::string_view::string_view;
+};
+template <typename T> class ArrayView {
+  public:
+    constexpr ArrayView() = default;
+    constexpr ArrayView(const T *data, std::size_t size) : ptr(data), count(size) {}
+
+    [[nodiscard]] constexpr const T *data() const { return ptr; }
+    [[nodiscard]] constexpr std::size_t size() const { return count; }
+    [[nodiscard]] constexpr bool empty() const { return count == 0; }
+    [[nodiscard]] constexpr const T *begin() const { return ptr; }
+    [[nodiscard]] constexpr const T *end() const { return ptr + count; }
+    constexpr const T &operator[](std::size_t index) const { return ptr[index]; }
+
+  private:
+    const T *ptr{nullptr};
+    std::size_t count{0};
+};
+
 template <typename... T> using Struct = std::tuple<T...>;
 template <typename... T> using Variant = std::variant<T...>;
 template <typename T> using Array = std::vector<T>;
 template <typename Key, typename Val> using DictEntry = std::pair<Key, Val>;
 template <typename Key, typename Val> using Dict = std::map<Key, Val>;
+template <typename Key, typename Val> using UnorderedDict = std::unordered_map<Key, Val>;
+
+// Dictionary stored as a vector of entries sorted on key, cheap to build in one go and cache friendly to look up.
+template <typename Key, typename Val, typename Compare = std::less<>> class FlatDict {
+  public:
+    using Entry = std::pair<Key, Val>;
+    using Entries = std::vector<Entry>;
+
+    FlatDict() = default;
+    // Entries do not need to be sorted, of duplicate keys the first one is kept.
+    explicit FlatDict(Entries unsorted) : entries(std::move(unsorted)) {
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Entry &lhs, const Entry &rhs) { return Compare{}(lhs.first, rhs.first); });
+        entries.erase(std::unique(entries.begin(), entries.end(),
+                                  [](const Entry &lhs, const Entry &rhs) {
+                                      return !Compare{}(lhs.first, rhs.first) && !Compare{}(rhs.first, lhs.first);
+                                  }),
+                      entries.end());
+    }
+    FlatDict(std::initializer_list<Entry> init) : FlatDict(Entries(init)) {}
+
+    [[nodiscard]] auto begin() const { return entries.begin(); }
+    [[nodiscard]] auto end() const { return entries.end(); }
+    [[nodiscard]] std::size_t size() const { return entries.size(); }
+    [[nodiscard]] bool empty() const { return entries.empty(); }
+
+    template <typename K> [[nodiscard]] auto find(const K &key) const {
+        auto it = lowerBound(key);
+        return (it != entries.end() && !Compare{}(key, it->first)) ? it : entries.end();
+    }
+    template <typename K> [[nodiscard]] bool contains(const K &key) const { return find(key) != entries.end(); }
+    template <typename K> [[nodiscard]] const Val &at(const K &key) const {
+        auto it = find(key);
+        if (it == entries.end()) {
+            throw std::out_of_range("FlatDict::at");
+        }
+        return it->second;
+    }
+
+    // Keeps the entries sorted, prefer building the whole dictionary at once.
+    std::pair<typename Entries::const_iterator, bool> insert(Entry entry) {
+        auto it = lowerBound(entry.first);
+        if (it != entries.end() && !Compare{}(entry.first, it->first)) {
+            return {it, false};
+        }
+        return {entries.insert(it, std::move(entry)), true};
+    }
+
+    bool operator==(const FlatDict &other) const { return entries == other.entries; }
+    bool operator!=(const FlatDict &other) const { return entries != other.entries; }
+
+  private:
+    template <typename K> auto lowerBound(const K &key) const {
+        return std::lower_bound(entries.begin(), entries.end(), key,
+                                [](const Entry &entry, const K &value) { return Compare{}(entry.first, value); });
+    }
+
+    Entries entries;
+};
 
 } // namespace type
 
@@ -64,36 +207,87 @@ struct ParseException : public std::runtime_error {
                         dbusTypeToChar(typeReceived)) {}
 };
 
+// A D-Bus type signature built at compile time.
+template <std::size_t N> struct SignatureString {
+    std::array<char, N + 1> chars{};
+
+    [[nodiscard]] constexpr std::string_view view() const { return {chars.data(), N}; }
+    [[nodiscard]] constexpr const char *c_str() const { return chars.data(); }
+};
+
+template <char... CHARS> constexpr SignatureString<sizeof...(CHARS)> makeSignature() { return {{CHARS..., '\0'}}; }
+
+template <std::size_t... N> constexpr auto concatSignatures(const SignatureString<N> &...parts) {
+    SignatureString<(N + ... + 0)> result{};
+    std::size_t pos = 0;
+    [[maybe_unused]] auto append = [&result, &pos](const auto &part) {
+        for (char chr : part.view()) {
+            result.chars[pos++] = chr;
+        }
+    };
+    (append(parts), ...);
+    return result;
+}
+
+inline void checkAppend(dbus_bool_t appended) {
+    if (!appended) {
+        throw std::runtime_error("Could not append dbus argument");
+    }
+}
+
 template <typename Type, int DBUS_TYPE> struct ParserHelper {
     static constexpr inline bool accept(int dbusType) { return dbusType == DBUS_TYPE; }
+    static constexpr auto signature = makeSignature<static_cast<char>(DBUS_TYPE)>();
+    // False when the signature does not fully describe the accepted messages, e.g. for Ignore.
+    static constexpr bool exactSignature = true;
 };
 
 template <typename Type, int DBUS_TYPE> struct BasicTypeParserHelper : ParserHelper<Type, DBUS_TYPE> {
     using ParserHelper<Type, DBUS_TYPE>::accept;
-    static void addArgument(DBusMessage *msg, Type val) {
-        dbus_message_append_args(msg, DBUS_TYPE, &val, DBUS_TYPE_INVALID);
+    // libdbus reads and writes booleans as 4 byte dbus_bool_t.
+    using WireType = std::conditional_t<std::is_same_v<Type, bool>, dbus_bool_t, Type>;
+    static void append(DBusMessageIter *iter, const Type &val) {
+        auto wire = static_cast<WireType>(val);
+        checkAppend(dbus_message_iter_append_basic(iter, DBUS_TYPE, &wire));
     }
-    static Type parse(DBusMessageIter *iter) {
+    template <bool CHECKED = true> static Type parse(DBusMessageIter *iter) {
         // cout << "Parsing buildin" << endl;
-        if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
-            throw ParseException(type, DBUS_TYPE);
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE);
+            }
         }
-        Type val{};
+        WireType val{};
         dbus_message_iter_get_basic(iter, &val);
-        return val;
+        return static_cast<Type>(val);
     }
 };
 
 template <typename Type, int DBUS_TYPE> struct StringParserHelper : ParserHelper<Type, DBUS_TYPE> {
     using ParserHelper<Type, DBUS_TYPE>::accept;
-    static void addArgument(DBusMessage *msg, std::string_view val) {
-        auto addr = val.data();
-        dbus_message_append_args(msg, DBUS_TYPE, &addr, DBUS_TYPE_INVALID);
+    static constexpr std::size_t SHORT_STRING = 256;
+    static void append(DBusMessageIter *iter, const char *val) {
+        checkAppend(dbus_message_iter_append_basic(iter, DBUS_TYPE, &val));
     }
-    static Type parse(DBusMessageIter *iter) {
+    static void append(DBusMessageIter *iter, const std::string &val) { append(iter, val.c_str()); }
+    // A string_view is not necessarily null terminated, short ones are terminated in a stack buffer instead of a copy
+    // on the heap.
+    static void append(DBusMessageIter *iter, std::string_view val) {
+        if (val.size() >= SHORT_STRING) {
+            append(iter, std::string{val});
+            return;
+        }
+        std::array<char, SHORT_STRING> buffer;
+        std::memcpy(buffer.data(), val.data(), val.size());
+        buffer[val.size()] = '\0';
+        append(iter, buffer.data());
+    }
+    template <bool CHECKED = true> static Type parse(DBusMessageIter *iter) {
         // cout << "Parsing string-like" << endl;
-        if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
-            throw ParseException(type, DBUS_TYPE);
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE);
+            }
         }
         const char *str;
         dbus_message_iter_get_basic(iter, &str);
@@ -102,7 +296,88 @@ template <typename Type, int DBUS_TYPE> struct StringParserHelper : ParserHelper
     }
 };
 
+template <typename Type, int DBUS_TYPE> struct StringViewParserHelper : StringParserHelper<Type, DBUS_TYPE> {
+    using ParserHelper<Type, DBUS_TYPE>::accept;
+    template <bool CHECKED = true> static Type parse(DBusMessageIter *iter) {
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE);
+            }
+        }
+        const char *str;
+        dbus_message_iter_get_basic(iter, &str);
+        return str;
+    }
+};
+
+// Types that are marshalled as-is, so arrays of them can be accessed as a contiguous block. Booleans are excluded as
+// they are 4 bytes on the wire.
+template <typename T>
+inline constexpr bool isFixedType =
+    std::is_same_v<T, type::U8> || std::is_same_v<T, type::I16> || std::is_same_v<T, type::U16> ||
+    std::is_same_v<T, type::I32> || std::is_same_v<T, type::U32> || std::is_same_v<T, type::I64> ||
+    std::is_same_v<T, type::U64> || std::is_same_v<T, type::Double>;
+
+// Whether parsing T yields views into the message.
+template <typename T> struct ContainsView : std::false_type {};
+template <> struct ContainsView<type::StringView> : std::true_type {};
+template <> struct ContainsView<type::ObjectPathView> : std::true_type {};
+template <> struct ContainsView<type::SignatureView> : std::true_type {};
+template <typename T> struct ContainsView<type::ArrayView<T>> : std::true_type {};
+template <typename T> struct ContainsView<type::Array<T>> : ContainsView<T> {};
+template <typename Key, typename Val>
+struct ContainsView<type::DictEntry<Key, Val>> : std::disjunction<ContainsView<Key>, ContainsView<Val>> {};
+template <typename Key, typename Val, typename... REST>
+struct ContainsView<std::map<Key, Val, REST...>> : std::disjunction<ContainsView<Key>, ContainsView<Val>> {};
+template <typename Key, typename Val, typename... REST>
+struct ContainsView<std::unordered_map<Key, Val, REST...>> : std::disjunction<ContainsView<Key>, ContainsView<Val>> {};
+template <typename Key, typename Val, typename Compare>
+struct ContainsView<type::FlatDict<Key, Val, Compare>> : std::disjunction<ContainsView<Key>, ContainsView<Val>> {};
+template <typename... T> struct ContainsView<type::Struct<T...>> : std::disjunction<ContainsView<T>...> {};
+template <typename... T> struct ContainsView<type::Variant<T...>> : std::disjunction<ContainsView<T>...> {};
+template <typename T> inline constexpr bool containsView = ContainsView<T>::value;
+
 template <typename T> struct Parser;
+
+// Calls callback(DBusMessageIter *) for every element of the container iter was recursed into. When the signature was
+// validated up front the per-element type check is skipped, the end is detected by dbus_message_iter_next instead.
+template <bool CHECKED, typename CALLBACK> void forEachElement(DBusMessageIter *iter, CALLBACK &&callback) {
+    if constexpr (CHECKED) {
+        for (; dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_INVALID; dbus_message_iter_next(iter)) {
+            callback(iter);
+        }
+    } else {
+        if (dbus_message_iter_get_arg_type(iter) == DBUS_TYPE_INVALID) {
+            return;
+        }
+        do {
+            callback(iter);
+        } while (dbus_message_iter_next(iter));
+    }
+}
+
+// Opens a container on iter, lets callback(DBusMessageIter *) fill it and closes it again.
+template <typename CALLBACK>
+void appendContainer(DBusMessageIter *iter, int type, const char *signature, CALLBACK &&callback) {
+    DBusMessageIter subIter;
+    checkAppend(dbus_message_iter_open_container(iter, type, signature, &subIter));
+    try {
+        callback(&subIter);
+    } catch (...) {
+        dbus_message_iter_abandon_container(iter, &subIter);
+        throw;
+    }
+    checkAppend(dbus_message_iter_close_container(iter, &subIter));
+}
+
+// Appends an array of fixed size elements as a single block.
+template <typename T> void appendFixedArray(DBusMessageIter *iter, const T *data, std::size_t count) {
+    appendContainer(iter, DBUS_TYPE_ARRAY, Parser<T>::signature.c_str(), [data, count](DBusMessageIter *subIter) {
+        checkAppend(dbus_message_iter_append_fixed_array(subIter, Parser<T>::signature.chars[0], &data,
+                                                         static_cast<int>(count)));
+    });
+}
+
 template <> struct Parser<type::U8> : BasicTypeParserHelper<type::U8, DBUS_TYPE_BYTE> {};
 template <> struct Parser<type::Boolean> : BasicTypeParserHelper<type::Boolean, DBUS_TYPE_BOOLEAN> {};
 template <> struct Parser<type::I16> : BasicTypeParserHelper<type::I16, DBUS_TYPE_INT16> {};
@@ -112,19 +387,66 @@ template <> struct Parser<type::U32> : BasicTypeParserHelper<type::U32, DBUS_TYP
 template <> struct Parser<type::I64> : BasicTypeParserHelper<type::I64, DBUS_TYPE_INT64> {};
 template <> struct Parser<type::U64> : BasicTypeParserHelper<type::U64, DBUS_TYPE_UINT64> {};
 template <> struct Parser<type::Double> : BasicTypeParserHelper<type::Double, DBUS_TYPE_DOUBLE> {};
-template <>
-struct Parser<type::UnixFileDescriptor> : BasicTypeParserHelper<type::UnixFileDescriptor, DBUS_TYPE_UNIX_FD> {};
+template <> struct Parser<type::UnixFileDescriptor> : ParserHelper<type::UnixFileDescriptor, DBUS_TYPE_UNIX_FD> {
+    template <bool CHECKED = true> static type::UnixFileDescriptor parse(DBusMessageIter *iter) {
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE_UNIX_FD);
+            }
+        }
+        // libdbus hands out a duplicate on every read.
+        int fd = -1;
+        dbus_message_iter_get_basic(iter, &fd);
+        return type::UnixFileDescriptor{fd};
+    }
+
+    static void append(DBusMessageIter *iter, const type::UnixFileDescriptor &val) {
+        int fd = val.get();
+        checkAppend(dbus_message_iter_append_basic(iter, DBUS_TYPE_UNIX_FD, &fd));
+    }
+};
 
 template <> struct Parser<type::Ignore> {
     static constexpr bool accept([[maybe_unused]] int) { return true; }
-    static type::Ignore parse(DBusMessageIter *) { return {}; }
+    static constexpr auto signature = makeSignature<'*'>();
+    static constexpr bool exactSignature = false;
+    template <bool CHECKED = true> static type::Ignore parse(DBusMessageIter *) { return {}; }
 };
 
 template <> struct Parser<type::String> : StringParserHelper<type::String, DBUS_TYPE_STRING> {};
 template <> struct Parser<const char *> : StringParserHelper<type::String, DBUS_TYPE_STRING> {};
-template <> struct Parser<std::string_view> : StringParserHelper<type::String, DBUS_TYPE_STRING> {};
 template <> struct Parser<type::ObjectPath> : StringParserHelper<type::ObjectPath, DBUS_TYPE_OBJECT_PATH> {};
-template <> struct Parser<type::Signature> : StringParserHelper<type::ObjectPath, DBUS_TYPE_SIGNATURE> {};
+template <> struct Parser<type::Signature> : StringParserHelper<type::Signature, DBUS_TYPE_SIGNATURE> {};
+template <> struct Parser<type::StringView> : StringViewParserHelper<type::StringView, DBUS_TYPE_STRING> {};
+template <>
+struct Parser<type::ObjectPathView> : StringViewParserHelper<type::ObjectPathView, DBUS_TYPE_OBJECT_PATH> {};
+template <> struct Parser<type::SignatureView> : StringViewParserHelper<type::SignatureView, DBUS_TYPE_SIGNATURE> {};
+
+template <typename T> struct Parser<type::ArrayView<T>> : ParserHelper<type::ArrayView<T>, DBUS_TYPE_ARRAY> {
+    static_assert(isFixedType<T>, "ArrayView requires a fixed size element type");
+    using Type = type::ArrayView<T>;
+    using ParserHelper<Type, DBUS_TYPE_ARRAY>::accept;
+    static constexpr auto signature = concatSignatures(makeSignature<'a'>(), Parser<T>::signature);
+    template <bool CHECKED = true> static Type parse(DBusMessageIter *iter) {
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE_ARRAY);
+            }
+            if (auto type = dbus_message_iter_get_element_type(iter); !Parser<T>::accept(type)) {
+                throw ParseException(std::string{"Unexpected array element type "} +
+                                     ParseException::dbusTypeToChar(type));
+            }
+        }
+        DBusMessageIter subIter;
+        dbus_message_iter_recurse(iter, &subIter);
+        const T *data = nullptr;
+        int count = 0;
+        dbus_message_iter_get_fixed_array(&subIter, &data, &count);
+        return {data, static_cast<std::size_t>(count)};
+    }
+
+    static void append(DBusMessageIter *iter, const Type &val) { appendFixedArray(iter, val.data(), val.size()); }
+};
 
 // template <typename T> struct Parser<type::String> : StringParserHelper<type::String, DBUS_TYPE_STRING> {};
 
@@ -134,6 +456,7 @@ struct Parser<type::Variant<TYPES...>> : ParserHelper<type::Variant<TYPES...>, D
     using ParserHelper<Type, DBUS_TYPE_VARIANT>::accept;
     template <typename T, typename... REST> static Type parseInner(int type, DBusMessageIter *iter) {
         if (Parser<T>::accept(type)) {
+            // The alternative is picked on the outer type only, so its content is always checked.
             return Parser<T>::parse(iter);
         }
         if constexpr (sizeof...(REST) > 0) {
@@ -142,37 +465,66 @@ struct Parser<type::Variant<TYPES...>> : ParserHelper<type::Variant<TYPES...>, D
         throw ParseException(std::string{"No matching variant type found for "} + ParseException::dbusTypeToChar(type));
     }
 
-    static auto parse(DBusMessageIter *iter) {
+    template <bool CHECKED = true> static auto parse(DBusMessageIter *iter) {
         // cout << "Parsing variant" << endl;
-        if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
-            throw ParseException(type, DBUS_TYPE_VARIANT);
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE_VARIANT);
+            }
         }
         DBusMessageIter subIter;
         dbus_message_iter_recurse(iter, &subIter);
         return parseInner<TYPES...>(dbus_message_iter_get_arg_type(&subIter), &subIter);
     }
+
+    static void append(DBusMessageIter *iter, const Type &val) {
+        std::visit(
+            [iter](const auto &content) {
+                using Content = std::decay_t<decltype(content)>;
+                appendContainer(iter, DBUS_TYPE_VARIANT, Parser<Content>::signature.c_str(),
+                                [&content](DBusMessageIter *subIter) { Parser<Content>::append(subIter, content); });
+            },
+            val);
+    }
 };
 
 template <typename T> struct Parser<type::Array<T>> : ParserHelper<type::Array<T>, DBUS_TYPE_ARRAY> {
     using Type = type::Array<T>;
     using ParserHelper<Type, DBUS_TYPE_ARRAY>::accept;
-    static Type parse(DBusMessageIter *iter) {
+    static constexpr auto signature = concatSignatures(makeSignature<'a'>(), Parser<T>::signature);
+    static constexpr bool exactSignature = Parser<T>::exactSignature;
+    template <bool CHECKED = true> static Type parse(DBusMessageIter *iter) {
         // cout << "Parsing array" << endl;
-        if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
-            throw ParseException(type, DBUS_TYPE_ARRAY);
-        }
-        Type response;
-        DBusMessageIter subIter;
-        dbus_message_iter_recurse(iter, &subIter);
-        while (true) {
-            int type = dbus_message_iter_get_arg_type(&subIter);
-            if (type == DBUS_TYPE_INVALID) {
-                break;
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE_ARRAY);
             }
-            response.emplace_back(Parser<T>::parse(&subIter));
-            dbus_message_iter_next(&subIter);
         }
-        return response;
+        if constexpr (isFixedType<T>) {
+            auto view = Parser<type::ArrayView<T>>::template parse<CHECKED>(iter);
+            return Type(view.begin(), view.end());
+        } else {
+            Type response;
+            response.reserve(static_cast<std::size_t>(dbus_message_iter_get_element_count(iter)));
+            DBusMessageIter subIter;
+            dbus_message_iter_recurse(iter, &subIter);
+            forEachElement<CHECKED>(&subIter, [&response](auto *elemIter) {
+                response.emplace_back(Parser<T>::template parse<CHECKED>(elemIter));
+            });
+            return response;
+        }
+    }
+
+    static void append(DBusMessageIter *iter, const Type &val) {
+        if constexpr (isFixedType<T>) {
+            appendFixedArray(iter, val.data(), val.size());
+        } else {
+            appendContainer(iter, DBUS_TYPE_ARRAY, Parser<T>::signature.c_str(), [&val](DBusMessageIter *subIter) {
+                for (const auto &element : val) {
+                    Parser<T>::append(subIter, element);
+                }
+            });
+        }
     }
 };
 
@@ -180,24 +532,35 @@ template <typename... TYPES>
 struct Parser<type::Struct<TYPES...>> : ParserHelper<type::Struct<TYPES...>, DBUS_TYPE_STRUCT> {
     using Type = type::Struct<TYPES...>;
     using ParserHelper<Type, DBUS_TYPE_STRUCT>::accept;
-    template <typename T, typename... REST> static auto parseInner(DBusMessageIter *iter) {
-        auto first = std::make_tuple<T>(Parser<T>::parse(iter));
+    static constexpr auto signature =
+        concatSignatures(makeSignature<'('>(), Parser<TYPES>::signature..., makeSignature<')'>());
+    static constexpr bool exactSignature = (Parser<TYPES>::exactSignature && ...);
+    template <bool CHECKED, typename T, typename... REST> static auto parseInner(DBusMessageIter *iter) {
+        auto first = std::make_tuple<T>(Parser<T>::template parse<CHECKED>(iter));
         if constexpr (sizeof...(REST) > 0) {
             dbus_message_iter_next(iter);
-            return std::tuple_cat(first, parseInner<REST...>(iter));
+            return std::tuple_cat(std::move(first), parseInner<CHECKED, REST...>(iter));
         } else {
             return first;
         }
     }
 
-    static Type parse(DBusMessageIter *iter) {
+    template <bool CHECKED = true> static Type parse(DBusMessageIter *iter) {
         // cout << "Parsing struct" << endl;
-        if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
-            throw ParseException(type, DBUS_TYPE_STRUCT);
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE_STRUCT);
+            }
         }
         DBusMessageIter subIter;
         dbus_message_iter_recurse(iter, &subIter);
-        return parseInner<TYPES...>(&subIter);
+        return parseInner<CHECKED, TYPES...>(&subIter);
+    }
+
+    static void append(DBusMessageIter *iter, const Type &val) {
+        appendContainer(iter, DBUS_TYPE_STRUCT, nullptr, [&val](DBusMessageIter *subIter) {
+            std::apply([subIter](const auto &...fields) { (Parser<TYPES>::append(subIter, fields), ...); }, val);
+        });
     }
 };
 
@@ -205,94 +568,386 @@ template <typename Key, typename Val>
 struct Parser<type::DictEntry<Key, Val>> : ParserHelper<type::DictEntry<Key, Val>, DBUS_TYPE_DICT_ENTRY> {
     using Type = type::DictEntry<Key, Val>;
     using ParserHelper<Type, DBUS_TYPE_DICT_ENTRY>::accept;
+    static constexpr auto signature =
+        concatSignatures(makeSignature<'{'>(), Parser<Key>::signature, Parser<Val>::signature, makeSignature<'}'>());
+    static constexpr bool exactSignature = Parser<Key>::exactSignature && Parser<Val>::exactSignature;
 
-    static auto parse(DBusMessageIter *iter) {
+    template <bool CHECKED = true> static auto parse(DBusMessageIter *iter) {
         // cout << "Parsing dictentry" << endl;
-        if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
-            throw ParseException(type, "ea");
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, "ea");
+            }
         }
         DBusMessageIter subIter;
         dbus_message_iter_recurse(iter, &subIter);
-        auto key = Parser<typename Type::first_type>::parse(&subIter);
+        auto key = Parser<typename Type::first_type>::template parse<CHECKED>(&subIter);
         dbus_message_iter_next(&subIter);
-        auto value = Parser<typename Type::second_type>::parse(&subIter);
-        return std::make_pair(key, value);
+        auto value = Parser<typename Type::second_type>::template parse<CHECKED>(&subIter);
+        return std::make_pair(std::move(key), std::move(value));
+    }
+
+    template <typename PAIR> static void append(DBusMessageIter *iter, const PAIR &val) {
+        appendContainer(iter, DBUS_TYPE_DICT_ENTRY, nullptr, [&val](DBusMessageIter *subIter) {
+            Parser<Key>::append(subIter, val.first);
+            Parser<Val>::append(subIter, val.second);
+        });
     }
 };
 
-template <typename Key, typename Val>
-struct Parser<type::Dict<Key, Val>> : ParserHelper<type::Dict<Key, Val>, DBUS_TYPE_ARRAY> {
-    using Type = type::Dict<Key, Val>;
+template <typename T, typename = void> struct HasReserve : std::false_type {};
+template <typename T>
+struct HasReserve<T, std::void_t<decltype(std::declval<T &>().reserve(std::size_t{}))>> : std::true_type {};
+
+template <typename T> struct IsFlatDict : std::false_type {};
+template <typename Key, typename Val, typename Compare>
+struct IsFlatDict<type::FlatDict<Key, Val, Compare>> : std::true_type {};
+
+// Shared by all dictionary targets. Targets that support it are reserved up front using the element count.
+template <typename Type, typename Key, typename Val> struct DictParserHelper : ParserHelper<Type, DBUS_TYPE_ARRAY> {
+    using EntryParser = Parser<type::DictEntry<Key, Val>>;
     using ParserHelper<Type, DBUS_TYPE_ARRAY>::accept;
-    static Type parse(DBusMessageIter *iter) {
+    static constexpr auto signature = concatSignatures(makeSignature<'a'>(), EntryParser::signature);
+    static constexpr bool exactSignature = EntryParser::exactSignature;
+    template <bool CHECKED = true> static Type parse(DBusMessageIter *iter) {
         // cout << "Parsing dict" << endl;
-        if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
-            throw ParseException(type, DBUS_TYPE_ARRAY);
+        if constexpr (CHECKED) {
+            if (auto type = dbus_message_iter_get_arg_type(iter); !accept(type)) {
+                throw ParseException(type, DBUS_TYPE_ARRAY);
+            }
         }
-        Type response;
         DBusMessageIter subIter;
         dbus_message_iter_recurse(iter, &subIter);
-        while (true) {
-            int type = dbus_message_iter_get_arg_type(&subIter);
-            if (type == DBUS_TYPE_INVALID) {
-                break;
+        if constexpr (IsFlatDict<Type>::value) {
+            typename Type::Entries entries;
+            entries.reserve(static_cast<std::size_t>(dbus_message_iter_get_element_count(iter)));
+            forEachElement<CHECKED>(&subIter, [&entries](auto *elemIter) {
+                entries.push_back(EntryParser::template parse<CHECKED>(elemIter));
+            });
+            return Type(std::move(entries));
+        } else {
+            Type response;
+            if constexpr (HasReserve<Type>::value) {
+                response.reserve(static_cast<std::size_t>(dbus_message_iter_get_element_count(iter)));
             }
-            response.insert(Parser<type::DictEntry<Key, Val>>::parse(&subIter));
-            dbus_message_iter_next(&subIter);
+            forEachElement<CHECKED>(&subIter, [&response](auto *elemIter) {
+                response.insert(EntryParser::template parse<CHECKED>(elemIter));
+            });
+            return response;
         }
-        return response;
+    }
+
+    static void append(DBusMessageIter *iter, const Type &val) {
+        appendContainer(iter, DBUS_TYPE_ARRAY, EntryParser::signature.c_str(), [&val](DBusMessageIter *subIter) {
+            for (const auto &entry : val) {
+                EntryParser::append(subIter, entry);
+            }
+        });
+    }
+};
+
+template <typename Key, typename Val, typename... REST>
+struct Parser<std::map<Key, Val, REST...>> : DictParserHelper<std::map<Key, Val, REST...>, Key, Val> {};
+template <typename Key, typename Val, typename... REST>
+struct Parser<std::unordered_map<Key, Val, REST...>>
+    : DictParserHelper<std::unordered_map<Key, Val, REST...>, Key, Val> {};
+template <typename Key, typename Val, typename Compare>
+struct Parser<type::FlatDict<Key, Val, Compare>> : DictParserHelper<type::FlatDict<Key, Val, Compare>, Key, Val> {};
+
+template <typename T> inline constexpr std::string_view signatureOf = Parser<T>::signature.view();
+
+// Consecutive top-level arguments, e.g. the arguments of a signal or method call.
+template <typename... TYPES> struct Arguments {
+    static constexpr auto signature = concatSignatures(Parser<TYPES>::signature...);
+    static constexpr bool exactSignature = (Parser<TYPES>::exactSignature && ...);
+
+    template <bool CHECKED = true> static std::tuple<TYPES...> parse(DBusMessageIter *iter) {
+        [[maybe_unused]] auto next = [iter](auto value) {
+            dbus_message_iter_next(iter);
+            return value;
+        };
+        return std::tuple<TYPES...>{next(Parser<TYPES>::template parse<CHECKED>(iter))...};
     }
 };
 
-// template <> struct Parser<std::any> {
-//     using Type = std::any;
-//     static constexpr bool accept([[maybe_unused]] int) { return true; }
-
-//     static Type parse(DBusMessageIter *iter) {
-//         // cout << "Parsing any" << endl;
-//         auto type = dbus_message_iter_get_arg_type(iter);
-//         switch (type) {
-//             DBusMessageIter subIter;
-//             case DBUS_TYPE_BYTE:
-//                 return Parser<type::U8>::parse(iter);
-//             case DBUS_TYPE_BOOLEAN:
-//                 return Parser<type::Boolean>::parse(iter);
-//             case DBUS_TYPE_INT16:
-//                 return Parser<type::I16>::parse(iter);
-//             case DBUS_TYPE_UINT16:
-//                 return Parser<type::U16>::parse(iter);
-//             case DBUS_TYPE_INT32:
-//                 return Parser<type::I32>::parse(iter);
-//             case DBUS_TYPE_UINT32:
-//                 return Parser<type::U32>::parse(iter);
-//             case DBUS_TYPE_INT64:
-//                 return Parser<type::I64>::parse(iter);
-//             case DBUS_TYPE_UINT64:
-//                 return Parser<type::U64>::parse(iter);
-//             case DBUS_TYPE_DOUBLE:
-//                 return Parser<type::Double>::parse(iter);
-//             case DBUS_TYPE_UNIX_FD:
-//                 return Parser<type::UnixFileDescriptor>::parse(iter);
-//             case DBUS_TYPE_STRING:
-//                 return Parser<type::String>::parse(iter);
-//             case DBUS_TYPE_OBJECT_PATH:
-//                 return Parser<type::ObjectPath>::parse(iter);
-//             case DBUS_TYPE_VARIANT:
-//                 dbus_message_iter_recurse(iter, &subIter);
-//                 return Parser<std::any>::parse(&subIter);
-//             case DBUS_TYPE_DICT_ENTRY:
-//                 return Parser<type::DictEntry<std::any, std::any>>::parse(iter);
-//             case DBUS_TYPE_ARRAY:
-//             case DBUS_TYPE_STRUCT:
-//                 return Parser<type::Array<std::any>>::parse(iter);
-//             default:
-//                 throw ParseException(std::string{"No matching variant type found for "} +
-//                                      ParseException::dbusTypeToChar(type));
-//         };
-//     }
-// };
+template <typename... TYPES> std::tuple<TYPES...> parseArguments(DBusMessageIter *iter) {
+    return Arguments<TYPES...>::parse(iter);
+}
+
+// Bump allocator for objects that are trivially destructible, everything is freed at once when the arena is destroyed.
+class Arena {
+  public:
+    template <typename T> T *allocate(std::size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed");
+        if (count == 0) {
+            return nullptr;
+        }
+        std::size_t size = sizeof(T) * count;
+        std::size_t padding = (alignof(T) - reinterpret_cast<std::uintptr_t>(current) % alignof(T)) % alignof(T);
+        if (current == nullptr || padding + size > remaining) {
+            std::size_t blockSize = std::max(BLOCK_SIZE, size + alignof(T));
+            blocks.emplace_back(new std::byte[blockSize]);
+            current = blocks.back().get();
+            remaining = blockSize;
+            padding = (alignof(T) - reinterpret_cast<std::uintptr_t>(current) % alignof(T)) % alignof(T);
+        }
+        auto *result = reinterpret_cast<T *>(current + padding);
+        current += padding + size;
+        remaining -= padding + size;
+        return result;
+    }
+
+  private:
+    static constexpr std::size_t BLOCK_SIZE = 4096;
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    std::byte *current{nullptr};
+    std::size_t remaining{0};
+};
 
 } // namespace parsers
 
+namespace type {
+
+// Any D-Bus value, for replies whose type is not known up front. Values are created by a ValueTree and are only valid
+// as long as it is, strings point into its message. Arrays of fixed types are not split into elements but kept as
+// views of the message data, their elements are created on access.
+class Value {
+  public:
+    Value() = default;
+
+    // The DBUS_TYPE_* of the value, DBUS_TYPE_INVALID for a default constructed value.
+    [[nodiscard]] int type() const { return dbusType; }
+    // The DBUS_TYPE_* of the elements of an array.
+    [[nodiscard]] int elementType() const { return elemType; }
+    [[nodiscard]] bool isContainer() const { return dbus_type_is_container(dbusType) != 0; }
+
+    // Number of elements of an array, fields of a struct or characters of a string.
+    [[nodiscard]] std::size_t size() const { return count; }
+
+    // Element of an array or field of a struct, the key (0) and value (1) of a dict entry or the content (0) of a
+    // variant.
+    Value operator[](std::size_t index) const {
+        if (!isContainer() || index >= count) {
+            throw std::out_of_range("Value index out of range");
+        }
+        if (dbusType == DBUS_TYPE_ARRAY && isFixedArray()) {
+            Value element;
+            element.dbusType = elemType;
+            std::memcpy(&element.data.basic, static_cast<const char *>(data.fixed) + index * fixedSize(elemType),
+                        fixedSize(elemType));
+            return element;
+        }
+        return data.children[index];
+    }
+
+    [[nodiscard]] Value key() const { return (*this)[0]; }
+    [[nodiscard]] Value value() const { return (*this)[1]; }
+    [[nodiscard]] Value content() const { return (*this)[0]; }
+
+    // The value of the entry with the given string-like key, for arrays of dict entries such as a{sv}.
+    [[nodiscard]] std::optional<Value> find(std::string_view name) const {
+        if (dbusType != DBUS_TYPE_ARRAY || elemType != DBUS_TYPE_DICT_ENTRY) {
+            return std::nullopt;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto &entry = data.children[i];
+            const auto &entryKey = entry.data.children[0];
+            if (dbus_type_is_basic(entryKey.dbusType) && !dbus_type_is_fixed(entryKey.dbusType) &&
+                std::string_view{entryKey.data.basic.str, entryKey.count} == name) {
+                return entry.data.children[1];
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Reads a basic value, T is one of the basic types, string types or string views.
+    template <typename T> [[nodiscard]] T get() const {
+        if (!parsers::Parser<T>::accept(dbusType)) {
+            throw parsers::ParseException(dbusType, parsers::Parser<T>::signature.chars[0]);
+        }
+        if constexpr (std::is_same_v<T, bool>) {
+            return data.basic.bool_val != 0;
+        } else if constexpr (std::is_same_v<T, UnixFileDescriptor>) {
+            // The tree keeps its own descriptor, the caller gets a duplicate.
+            return UnixFileDescriptor::duplicate(data.basic.fd);
+        } else if constexpr (std::is_constructible_v<T, const char *, std::size_t>) {
+            return T{data.basic.str, count};
+        } else {
+            static_assert(parsers::isFixedType<T>, "Value::get() only reads basic types");
+            T result;
+            std::memcpy(&result, &data.basic, sizeof(T));
+            return result;
+        }
+    }
+
+    // The elements of an array of a fixed type, without copying.
+    template <typename T> [[nodiscard]] ArrayView<T> fixedArray() const {
+        static_assert(parsers::isFixedType<T>, "Only arrays of fixed types can be viewed");
+        if (dbusType != DBUS_TYPE_ARRAY || !parsers::Parser<T>::accept(elemType)) {
+            throw parsers::ParseException(dbusType == DBUS_TYPE_ARRAY ? elemType : dbusType,
+                                          parsers::Parser<T>::signature.chars[0]);
+        }
+        return {static_cast<const T *>(data.fixed), count};
+    }
+
+    // Calls visitor with the value of a basic type (string-like types as their view) or with the Value itself for
+    // containers.
+    template <typename VISITOR> decltype(auto) visit(VISITOR &&visitor) const {
+        switch (dbusType) {
+            case DBUS_TYPE_BYTE:
+                return visitor(get<U8>());
+            case DBUS_TYPE_BOOLEAN:
+                return visitor(get<Boolean>());
+            case DBUS_TYPE_INT16:
+                return visitor(get<I16>());
+            case DBUS_TYPE_UINT16:
+                return visitor(get<U16>());
+            case DBUS_TYPE_INT32:
+                return visitor(get<I32>());
+            case DBUS_TYPE_UINT32:
+                return visitor(get<U32>());
+            case DBUS_TYPE_INT64:
+                return visitor(get<I64>());
+            case DBUS_TYPE_UINT64:
+                return visitor(get<U64>());
+            case DBUS_TYPE_DOUBLE:
+                return visitor(get<Double>());
+            case DBUS_TYPE_UNIX_FD:
+                return visitor(get<UnixFileDescriptor>());
+            case DBUS_TYPE_STRING:
+                return visitor(get<StringView>());
+            case DBUS_TYPE_OBJECT_PATH:
+                return visitor(get<ObjectPathView>());
+            case DBUS_TYPE_SIGNATURE:
+                return visitor(get<SignatureView>());
+            default:
+                return visitor(*this);
+        }
+    }
+
+  private:
+    friend class ValueTree;
+
+    [[nodiscard]] bool isFixedArray() const {
+        return dbus_type_is_fixed(elemType) && elemType != DBUS_TYPE_UNIX_FD;
+    }
+
+    static std::size_t fixedSize(int dbusType) {
+        switch (dbusType) {
+            case DBUS_TYPE_BYTE:
+                return 1;
+            case DBUS_TYPE_INT16:
+            case DBUS_TYPE_UINT16:
+                return 2;
+            case DBUS_TYPE_BOOLEAN:
+            case DBUS_TYPE_INT32:
+            case DBUS_TYPE_UINT32:
+                return 4;
+            default:
+                return 8;
+        }
+    }
+
+    int dbusType{DBUS_TYPE_INVALID};
+    int elemType{DBUS_TYPE_INVALID};
+    std::size_t count{0};
+    union {
+        DBusBasicValue basic;
+        const Value *children;
+        const void *fixed;
+    } data{};
+};
+
+// All arguments of a message as Values, parsed in a single pass. Nodes are allocated from an arena and strings point
+// into the message, both are owned by the tree. This saves the allocations of the typed parsers, not their time: both
+// are bound by the libdbus iterators.
+class ValueTree {
+  public:
+    explicit ValueTree(DBusMessage *msg) : msg({dbus_message_ref(msg), dbus_message_unref}) {
+        std::vector<Value> stack;
+        DBusMessageIter iter;
+        std::size_t count = dbus_message_iter_init(msg, &iter) ? readAll(&iter, stack) : 0;
+        args = commit(stack, count);
+    }
+    ValueTree(const ValueTree &) = delete;
+    ValueTree(ValueTree &&) = default;
+    ValueTree &operator=(const ValueTree &) = delete;
+    ValueTree &operator=(ValueTree &&) = default;
+    ~ValueTree() {
+        for (int fd : fds) {
+            close(fd);
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const { return args.size(); }
+    [[nodiscard]] const Value &operator[](std::size_t index) const { return args[index]; }
+    [[nodiscard]] const Value *begin() const { return args.begin(); }
+    [[nodiscard]] const Value *end() const { return args.end(); }
+
+  private:
+    // Children are collected on the stack and moved to the arena once complete, so they are contiguous.
+    std::size_t readAll(DBusMessageIter *iter, std::vector<Value> &stack) {
+        std::size_t count = 0;
+        for (; dbus_message_iter_get_arg_type(iter) != DBUS_TYPE_INVALID; dbus_message_iter_next(iter)) {
+            auto value = read(iter, dbus_message_iter_get_arg_type(iter), stack);
+            stack.push_back(value);
+            ++count;
+        }
+        return count;
+    }
+
+    ArrayView<Value> commit(std::vector<Value> &stack, std::size_t count) {
+        auto *nodes = arena.allocate<Value>(count);
+        std::copy(stack.end() - static_cast<std::ptrdiff_t>(count), stack.end(), nodes);
+        stack.resize(stack.size() - count);
+        return {nodes, count};
+    }
+
+    Value read(DBusMessageIter *iter, int type, std::vector<Value> &stack) {
+        Value value;
+        value.dbusType = type;
+        if (!dbus_type_is_container(type)) {
+            dbus_message_iter_get_basic(iter, &value.data.basic);
+            if (type == DBUS_TYPE_UNIX_FD) {
+                fds.push_back(value.data.basic.fd);
+            } else if (!dbus_type_is_fixed(type)) {
+                value.count = std::strlen(value.data.basic.str);
+            }
+            return value;
+        }
+
+        DBusMessageIter subIter;
+        dbus_message_iter_recurse(iter, &subIter);
+        if (type == DBUS_TYPE_ARRAY) {
+            value.elemType = dbus_message_iter_get_element_type(iter);
+            if (value.isFixedArray()) {
+                int elements = 0;
+                dbus_message_iter_get_fixed_array(&subIter, &value.data.fixed, &elements);
+                value.count = static_cast<std::size_t>(elements);
+                return value;
+            }
+        }
+        auto children = commit(stack, readAll(&subIter, stack));
+        value.data.children = children.data();
+        value.count = children.size();
+        return value;
+    }
+
+    std::unique_ptr<DBusMessage, void (*)(DBusMessage *)> msg;
+    parsers::Arena arena;
+    ArrayView<Value> args;
+    // Received file descriptors are owned by the tree.
+    std::vector<int> fds;
+};
+
+} // namespace type
+
 } // namespace v1
 } // namespace wibens::dbuspp
+
+// Allow the string-like types as keys of unordered dictionaries.
+template <> struct std::hash<wibens::dbuspp::type::ObjectPath> : std::hash<std::string> {};
+template <> struct std::hash<wibens::dbuspp::type::Signature> : std::hash<std::string> {};
+template <> struct std::hash<wibens::dbuspp::type::ObjectPathView> : std::hash<std::string_view> {};
+template <> struct std::hash<wibens::dbuspp::type::SignatureView> : std::hash<std::string_view> {};
@@ -0,0 +1,419 @@
+#pragma once
+
+#include "dbuspp.hpp"
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace wibens::dbuspp {
+inline namespace v1 {
+
+// Reads and writes message bodies in the D-Bus wire format directly, instead of through a DBusMessageIter per value.
+// Alignment and layout follow from the C++ types at compile time. Only owning types are supported (no views, Ignore or
+// file descriptors), anything else falls back to the parsers. Worth it for messages with many small values, e.g. a(ii)
+// or a{sv}, as the message is copied once to get at its bytes.
+namespace wire {
+
+inline constexpr char NATIVE_ENDIAN = __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? DBUS_LITTLE_ENDIAN : DBUS_BIG_ENDIAN;
+
+// Offsets in the fixed part of the header.
+inline constexpr std::size_t BODY_LENGTH_OFFSET = 4;
+inline constexpr std::size_t SERIAL_OFFSET = 8;
+inline constexpr std::size_t FIELDS_LENGTH_OFFSET = 12;
+inline constexpr std::size_t FIELDS_OFFSET = 16;
+
+inline constexpr std::size_t alignUp(std::size_t pos, std::size_t alignment) {
+    return (pos + alignment - 1) & ~(alignment - 1);
+}
+
+template <typename T> T byteSwap(T value) {
+    if constexpr (sizeof(T) == 1) {
+        return value;
+    } else {
+        using Bits =
+            std::conditional_t<sizeof(T) == 2, uint16_t, std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>;
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        if constexpr (sizeof(T) == 2) {
+            bits = __builtin_bswap16(bits);
+        } else if constexpr (sizeof(T) == 4) {
+            bits = __builtin_bswap32(bits);
+        } else {
+            bits = __builtin_bswap64(bits);
+        }
+        std::memcpy(&value, &bits, sizeof(T));
+        return value;
+    }
+}
+
+// A marshalled message, positions are relative to its start so alignment works out for the body as well.
+class Reader {
+  public:
+    Reader(const uint8_t *data, std::size_t size, std::size_t pos, bool swap)
+        : data(data), size(size), pos(pos), swap(swap) {}
+
+    void align(std::size_t alignment) { pos = alignUp(pos, alignment); }
+
+    template <typename T> T fixed() {
+        align(sizeof(T));
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return swap ? byteSwap(value) : value;
+    }
+
+    std::string_view string() {
+        auto length = fixed<uint32_t>();
+        const auto *chars = take(std::size_t{length} + 1);
+        return {reinterpret_cast<const char *>(chars), length};
+    }
+
+    std::string_view signature() {
+        auto length = *take(1);
+        const auto *chars = take(std::size_t{length} + 1);
+        return {reinterpret_cast<const char *>(chars), length};
+    }
+
+    const uint8_t *take(std::size_t count) {
+        if (count > size - std::min(pos, size)) {
+            throw parsers::ParseException("Truncated message");
+        }
+        const auto *taken = data + pos;
+        pos += count;
+        return taken;
+    }
+
+    [[nodiscard]] std::size_t position() const { return pos; }
+    [[nodiscard]] bool swapped() const { return swap; }
+
+  private:
+    const uint8_t *data;
+    std::size_t size;
+    std::size_t pos;
+    bool swap;
+};
+
+// Appends to a marshalled message in native byte order.
+class Writer {
+  public:
+    explicit Writer(std::vector<uint8_t> &buffer) : buffer(buffer) {}
+
+    void align(std::size_t alignment) { buffer.resize(alignUp(buffer.size(), alignment)); }
+
+    template <typename T> void fixed(T value) {
+        align(sizeof(T));
+        std::memcpy(grow(sizeof(T)), &value, sizeof(T));
+    }
+
+    void string(std::string_view str) {
+        fixed(static_cast<uint32_t>(str.size()));
+        std::memcpy(grow(str.size() + 1), str.data(), str.size());
+    }
+
+    void signature(std::string_view str) {
+        fixed(static_cast<uint8_t>(str.size()));
+        std::memcpy(grow(str.size() + 1), str.data(), str.size());
+    }
+
+    // Returns the position of the length, which is filled in by endArray().
+    std::size_t beginArray(std::size_t elementAlignment) {
+        fixed(uint32_t{0});
+        auto lengthPos = buffer.size() - sizeof(uint32_t);
+        align(elementAlignment);
+        return lengthPos;
+    }
+
+    void endArray(std::size_t lengthPos, std::size_t elementAlignment) {
+        auto length = static_cast<uint32_t>(buffer.size() - alignUp(lengthPos + sizeof(uint32_t), elementAlignment));
+        patch(lengthPos, length);
+    }
+
+    template <typename T> void patch(std::size_t pos, T value) { std::memcpy(buffer.data() + pos, &value, sizeof(T)); }
+
+    uint8_t *grow(std::size_t count) {
+        auto pos = buffer.size();
+        buffer.resize(pos + count);
+        return buffer.data() + pos;
+    }
+
+    [[nodiscard]] std::size_t size() const { return buffer.size(); }
+
+  private:
+    std::vector<uint8_t> &buffer;
+};
+
+template <typename T, typename = void> struct Codec {
+    static constexpr bool supported = false;
+};
+
+template <typename T> struct Codec<T, std::enable_if_t<parsers::isFixedType<T>>> {
+    static constexpr bool supported = true;
+    static constexpr std::size_t alignment = sizeof(T);
+    static T read(Reader &in) { return in.fixed<T>(); }
+    static void write(Writer &out, T val) { out.fixed(val); }
+};
+
+template <> struct Codec<type::Boolean> {
+    static constexpr bool supported = true;
+    static constexpr std::size_t alignment = 4;
+    static bool read(Reader &in) { return in.fixed<uint32_t>() != 0; }
+    static void write(Writer &out, bool val) { out.fixed(uint32_t{val ? 1U : 0U}); }
+};
+
+template <typename T> struct StringCodec {
+    static constexpr bool supported = true;
+    static constexpr std::size_t alignment = 4;
+    static T read(Reader &in) {
+        auto str = in.string();
+        return T(str.data(), str.size());
+    }
+    static void write(Writer &out, const T &val) { out.string(val); }
+};
+
+template <> struct Codec<type::String> : StringCodec<type::String> {};
+template <> struct Codec<type::ObjectPath> : StringCodec<type::ObjectPath> {};
+
+template <> struct Codec<type::Signature> {
+    static constexpr bool supported = true;
+    static constexpr std::size_t alignment = 1;
+    static type::Signature read(Reader &in) {
+        auto str = in.signature();
+        return {str.data(), str.size()};
+    }
+    static void write(Writer &out, const type::Signature &val) { out.signature(val); }
+};
+
+template <typename... TYPES> struct Codec<type::Struct<TYPES...>> {
+    static constexpr bool supported = (Codec<TYPES>::supported && ...);
+    static constexpr std::size_t alignment = 8;
+    static type::Struct<TYPES...> read(Reader &in) {
+        in.align(alignment);
+        // Braced initialization evaluates the fields in order.
+        return type::Struct<TYPES...>{Codec<TYPES>::read(in)...};
+    }
+    static void write(Writer &out, const type::Struct<TYPES...> &val) {
+        out.align(alignment);
+        std::apply([&out](const auto &...fields) { (Codec<TYPES>::write(out, fields), ...); }, val);
+    }
+};
+
+template <typename Key, typename Val> struct Codec<type::DictEntry<Key, Val>> {
+    static constexpr bool supported = Codec<Key>::supported && Codec<Val>::supported;
+    static constexpr std::size_t alignment = 8;
+    static type::DictEntry<Key, Val> read(Reader &in) {
+        in.align(alignment);
+        auto key = Codec<Key>::read(in);
+        return {std::move(key), Codec<Val>::read(in)};
+    }
+    template <typename PAIR> static void write(Writer &out, const PAIR &val) {
+        out.align(alignment);
+        Codec<Key>::write(out, val.first);
+        Codec<Val>::write(out, val.second);
+    }
+};
+
+// Calls element() until the array that starts at the reader position has been consumed.
+template <typename ELEMENT> void readArray(Reader &in, std::size_t elementAlignment, ELEMENT &&element) {
+    auto length = in.fixed<uint32_t>();
+    in.align(elementAlignment);
+    auto end = in.position() + length;
+    while (in.position() < end) {
+        element();
+    }
+}
+
+template <typename T> struct Codec<type::Array<T>> {
+    static constexpr bool supported = Codec<T>::supported;
+    static constexpr std::size_t alignment = 4;
+    static type::Array<T> read(Reader &in) {
+        if constexpr (parsers::isFixedType<T>) {
+            if (!in.swapped()) {
+                auto length = in.fixed<uint32_t>();
+                in.align(sizeof(T));
+                const auto *data = reinterpret_cast<const T *>(in.take(length));
+                return type::Array<T>(data, data + length / sizeof(T));
+            }
+        }
+        type::Array<T> result;
+        readArray(in, Codec<T>::alignment, [&in, &result] { result.push_back(Codec<T>::read(in)); });
+        return result;
+    }
+    static void write(Writer &out, const type::Array<T> &val) {
+        auto lengthPos = out.beginArray(Codec<T>::alignment);
+        if constexpr (parsers::isFixedType<T>) {
+            std::memcpy(out.grow(val.size() * sizeof(T)), val.data(), val.size() * sizeof(T));
+        } else {
+            for (const auto &element : val) {
+                Codec<T>::write(out, element);
+            }
+        }
+        out.endArray(lengthPos, Codec<T>::alignment);
+    }
+};
+
+template <typename Type, typename Key, typename Val> struct DictCodec {
+    using EntryCodec = Codec<type::DictEntry<Key, Val>>;
+    static constexpr bool supported = EntryCodec::supported;
+    static constexpr std::size_t alignment = 4;
+    static Type read(Reader &in) {
+        if constexpr (parsers::IsFlatDict<Type>::value) {
+            typename Type::Entries entries;
+            readArray(in, EntryCodec::alignment, [&in, &entries] { entries.push_back(EntryCodec::read(in)); });
+            return Type(std::move(entries));
+        } else {
+            Type result;
+            readArray(in, EntryCodec::alignment, [&in, &result] { result.insert(EntryCodec::read(in)); });
+            return result;
+        }
+    }
+    static void write(Writer &out, const Type &val) {
+        auto lengthPos = out.beginArray(EntryCodec::alignment);
+        for (const auto &entry : val) {
+            EntryCodec::write(out, entry);
+        }
+        out.endArray(lengthPos, EntryCodec::alignment);
+    }
+};
+
+template <typename Key, typename Val, typename... REST>
+struct Codec<std::map<Key, Val, REST...>> : DictCodec<std::map<Key, Val, REST...>, Key, Val> {};
+template <typename Key, typename Val, typename... REST>
+struct Codec<std::unordered_map<Key, Val, REST...>> : DictCodec<std::unordered_map<Key, Val, REST...>, Key, Val> {};
+template <typename Key, typename Val, typename Compare>
+struct Codec<type::FlatDict<Key, Val, Compare>> : DictCodec<type::FlatDict<Key, Val, Compare>, Key, Val> {};
+
+template <typename... TYPES> struct Codec<type::Variant<TYPES...>> {
+    using Type = type::Variant<TYPES...>;
+    static constexpr bool supported = (Codec<TYPES>::supported && ...);
+    static constexpr std::size_t alignment = 1;
+
+    // Unlike the parser the alternative has to match the full signature of the content.
+    template <typename T, typename... REST> static Type readInner(std::string_view signature, Reader &in) {
+        if (signature == parsers::signatureOf<T>) {
+            return Codec<T>::read(in);
+        }
+        if constexpr (sizeof...(REST) > 0) {
+            return readInner<REST...>(signature, in);
+        }
+        throw parsers::ParseException("No matching variant type found for " + std::string{signature});
+    }
+
+    static Type read(Reader &in) { return readInner<TYPES...>(in.signature(), in); }
+
+    static void write(Writer &out, const Type &val) {
+        std::visit(
+            [&out](const auto &content) {
+                using Content = std::decay_t<decltype(content)>;
+                out.signature(parsers::signatureOf<Content>);
+                Codec<Content>::write(out, content);
+            },
+            val);
+    }
+};
+
+template <typename... TYPES> inline constexpr bool isSupported = (Codec<std::decay_t<TYPES>>::supported && ...);
+
+// Values libdbus handles in a single call, for those copying the message costs more than the codec saves.
+template <typename T>
+struct IsFlat : std::bool_constant<parsers::isFixedType<T> || std::is_same_v<T, type::Boolean> ||
+                                   std::is_same_v<T, type::String> || std::is_same_v<T, type::ObjectPath> ||
+                                   std::is_same_v<T, type::Signature>> {};
+template <typename T> struct IsFlat<type::Array<T>> : std::bool_constant<parsers::isFixedType<T>> {};
+
+// Whether decodeArguments() and encode() use the codec for TYPES.
+template <typename... TYPES>
+inline constexpr bool usesCodec = isSupported<TYPES...> && !(IsFlat<std::decay_t<TYPES>>::value && ...);
+
+// Reads the arguments of msg. Falls back to parsers::Arguments when the codec is not used for TYPES or they do not
+// match the signature of msg exactly, so errors are reported the same way.
+template <typename... TYPES> std::tuple<TYPES...> decodeArguments(DBusMessage *msg) {
+    using Args = parsers::Arguments<TYPES...>;
+    if constexpr (usesCodec<TYPES...>) {
+        if (Args::signature.view() == dbus_message_get_signature(msg)) {
+            char *data = nullptr;
+            int length = 0;
+            if (!dbus_message_marshal(msg, &data, &length)) {
+                throw std::runtime_error("Could not marshal dbus message");
+            }
+            std::unique_ptr<char, void (*)(void *)> owned{data, dbus_free};
+            const auto *bytes = reinterpret_cast<const uint8_t *>(data);
+            bool swap = bytes[0] != NATIVE_ENDIAN;
+            Reader header{bytes, static_cast<std::size_t>(length), FIELDS_LENGTH_OFFSET, swap};
+            auto fieldsLength = header.fixed<uint32_t>();
+            Reader in{bytes, static_cast<std::size_t>(length), alignUp(FIELDS_OFFSET + fieldsLength, 8), swap};
+            return std::tuple<TYPES...>{Codec<TYPES>::read(in)...};
+        }
+    }
+    DBusMessageIter iter;
+    dbus_message_iter_init(msg, &iter);
+    return Args::parse(&iter);
+}
+
+// Like DBus::Reply::response<T>(), for a message with a single argument.
+template <typename T> T decode(DBusMessage *msg) { return std::get<0>(decodeArguments<T>(msg)); }
+
+// A copy of prototype, which must not have any arguments yet, with args appended. Falls back to
+// DBus::Message::addArguments() when the codec is not used for ARGS. Loading the result validates it, which limits the
+// gain compared to decoding.
+template <typename... ARGS> DBus::Message encode(const DBus::Message &prototype, const ARGS &...args) {
+    if constexpr (usesCodec<ARGS...>) {
+        char *data = nullptr;
+        int length = 0;
+        if (!dbus_message_marshal(prototype.get(), &data, &length)) {
+            throw std::runtime_error("Could not marshal dbus message");
+        }
+        std::unique_ptr<char, void (*)(void *)> owned{data, dbus_free};
+        const auto *bytes = reinterpret_cast<const uint8_t *>(data);
+        uint32_t fieldsLength = 0;
+        std::memcpy(&fieldsLength, bytes + FIELDS_LENGTH_OFFSET, sizeof(fieldsLength));
+        if (bytes[0] == NATIVE_ENDIAN && *dbus_message_get_signature(prototype.get()) == '\0') {
+            std::vector<uint8_t> buffer(bytes, bytes + FIELDS_OFFSET + fieldsLength);
+            Writer out{buffer};
+            static constexpr auto SIGNATURE = parsers::concatSignatures(parsers::Parser<ARGS>::signature...);
+            if constexpr (SIGNATURE.view().size() > 0) {
+                out.align(8);
+                out.fixed(static_cast<uint8_t>(DBUS_HEADER_FIELD_SIGNATURE));
+                out.signature(DBUS_TYPE_SIGNATURE_AS_STRING);
+                out.signature(SIGNATURE.view());
+                out.patch(FIELDS_LENGTH_OFFSET, static_cast<uint32_t>(out.size() - FIELDS_OFFSET));
+            }
+            out.align(8);
+            auto bodyStart = out.size();
+            (Codec<ARGS>::write(out, args), ...);
+            out.patch(BODY_LENGTH_OFFSET, static_cast<uint32_t>(out.size() - bodyStart));
+            // Loading requires a serial, the copy drops it again so the connection assigns a fresh one.
+            out.patch(SERIAL_OFFSET, uint32_t{1});
+
+            DBusError err;
+            dbus_error_init(&err);
+            DBusMessage *loaded = dbus_message_demarshal(reinterpret_cast<const char *>(buffer.data()),
+                                                         static_cast<int>(buffer.size()), &err);
+            if (dbus_error_is_set(&err)) {
+                std::string what = std::string{"Could not encode dbus message: "} + err.message;
+                dbus_error_free(&err);
+                throw std::runtime_error(what);
+            }
+            DBus::Message msg{dbus_message_copy(loaded)};
+            dbus_message_unref(loaded);
+            return msg;
+        }
+    }
+    DBus::Message msg{dbus_message_copy(prototype.get())};
+    msg.addArguments(args...);
+    return msg;
+}
+
+} // namespace wire
+} // namespace v1
+} // namespace wibens::dbuspp
@@ -0,0 +1,124 @@
+#include "wibens/dbuspp/dbuspp.hpp"
+#include "test.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+using namespace wibens::dbuspp;
+
+namespace {
+constexpr const char *PEER = "org.freedesktop.DBus.Peer";
+constexpr int SYNC_CALLS = 10;
+constexpr int ASYNC_CALLS = 10;
+
+const Instrumentation::MethodSnapshot *find(const std::vector<Instrumentation::MethodSnapshot> &snapshot,
+                                            std::string_view member) {
+    auto it = std::find_if(snapshot.begin(), snapshot.end(), [member](const auto &method) {
+        return method.destination == DBUS_SERVICE_DBUS && method.member == member;
+    });
+    return it == snapshot.end() ? nullptr : &*it;
+}
+
+uint64_t latencyCount(const Instrumentation::MethodSnapshot &method) {
+    return std::accumulate(method.latency.begin(), method.latency.end(), uint64_t{0});
+}
+} // namespace
+
+// Synchronous, asynchronous and failing calls are each recorded once, with both hooks called for them.
+int main() noexcept(false) {
+    std::unique_ptr<test::Daemon> daemon;
+    try {
+        daemon = std::make_unique<test::Daemon>();
+    } catch (const std::exception &e) {
+        std::printf("%s, skipping\n", e.what());
+        return test::SKIPPED;
+    }
+
+    auto instrumentation = std::make_shared<Instrumentation>();
+    int preCalls = 0;
+    int postCalls = 0;
+    int withoutReply = 0;
+    bool invalid = false;
+    instrumentation->setPreCallHook([&preCalls](DBusMessage *) { ++preCalls; });
+    instrumentation->setPostCallHook([&](DBusMessage *call, DBusMessage *reply, std::chrono::nanoseconds latency) {
+        ++postCalls;
+        withoutReply += reply == nullptr ? 1 : 0;
+        invalid = invalid || call == nullptr || latency.count() < 0;
+    });
+
+    auto dbus = DBus::openPrivate(DBUS_BUS_SESSION);
+    dbus.instrument(instrumentation);
+    for (int i = 0; i < SYNC_CALLS; ++i) {
+        dbus.call<type::String>(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, "GetId");
+    }
+    std::vector<DBus::PendingCall<type::String>> pending;
+    for (int i = 0; i < ASYNC_CALLS; ++i) {
+        pending.push_back(
+            dbus.callAsync<type::String>(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, "GetId"));
+    }
+    dbus.waitAll(pending);
+    for (auto &call : pending) {
+        call.get();
+    }
+
+    bool replied = false;
+    auto listed = dbus.callAsync<type::Array<type::String>>(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS,
+                                                            "ListNames");
+    listed.then([&replied](auto &call) {
+        call.get();
+        replied = true;
+    });
+    for (int i = 0; i < 1000 && !replied; ++i) {
+        dbus_connection_read_write_dispatch(dbus.get(), 10);
+    }
+    CHECK(replied);
+
+    bool threw = false;
+    try {
+        dbus.call<type::String>(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, DBUS_INTERFACE_DBUS, "GetNameOwner",
+                                "org.example.NobodyOwnsThis");
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    // Nothing can be sent once the connection is closed.
+    dbus_connection_close(dbus.get());
+    threw = false;
+    try {
+        dbus.callAsync(DBUS_SERVICE_DBUS, DBUS_PATH_DBUS, PEER, "Ping");
+    } catch (const std::runtime_error &) {
+        threw = true;
+    }
+    CHECK(threw);
+
+    auto snapshot = instrumentation->snapshot();
+    CHECK(snapshot.size() == 4);
+
+    const auto *getId = find(snapshot, "GetId");
+    CHECK(getId != nullptr && getId->interface == DBUS_INTERFACE_DBUS);
+    CHECK(getId->calls == SYNC_CALLS + ASYNC_CALLS && getId->errors == 0);
+    CHECK(latencyCount(*getId) == getId->calls);
+    CHECK(getId->bytesSent > 0 && getId->bytesReceived > 0);
+    CHECK(getId->percentile(0.5).count() > 0 && getId->percentile(0.5) <= getId->percentile(1.0));
+
+    const auto *listNames = find(snapshot, "ListNames");
+    CHECK(listNames != nullptr && listNames->calls == 1 && listNames->errors == 0 && listNames->bytesReceived > 0);
+
+    // libdbus turns the error reply of a blocking call into a DBusError, so the hook gets no reply for it.
+    const auto *getNameOwner = find(snapshot, "GetNameOwner");
+    CHECK(getNameOwner != nullptr && getNameOwner->calls == 1 && getNameOwner->errors == 1);
+
+    const auto *ping = find(snapshot, "Ping");
+    CHECK(ping != nullptr && ping->interface == PEER && ping->calls == 1 && ping->errors == 1);
+    CHECK(ping->bytesReceived == 0 && latencyCount(*ping) == 1);
+
+    auto total = SYNC_CALLS + ASYNC_CALLS + 3;
+    CHECK(preCalls == total && postCalls == total);
+    CHECK(withoutReply == 2 && !invalid);
+    return 0;
+}
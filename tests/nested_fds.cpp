@@ -0,0 +1,35 @@
+#include "wibens/dbuspp/dbuspp.hpp"
+#include "wibens/dbuspp/sharedblob.hpp"
+#include "test.hpp"
+#include <cstdio>
+#include <cstring>
+
+using namespace wibens::dbuspp;
+
+// Move-only fd types must round-trip inside structs, dict entries and arrays.
+int main() noexcept(false) {
+    using FdStruct = type::Struct<type::UnixFileDescriptor, type::I32>;
+    using FdDict = type::Dict<type::String, type::UnixFileDescriptor>;
+    using BlobDict = type::Dict<type::String, type::SharedBlob>;
+
+    FdStruct fdStruct{type::UnixFileDescriptor::duplicate(0), 7};
+    FdDict fdDict;
+    fdDict.emplace("stdin", type::UnixFileDescriptor::duplicate(0));
+    BlobDict blobDict;
+    blobDict.emplace("hello", type::SharedBlob{"hello", 5});
+    type::Array<FdStruct> fdArray;
+    fdArray.emplace_back(type::UnixFileDescriptor::duplicate(1), 3);
+
+    DBus::Message msg{dbus_message_new_method_call("org.example.Test", "/", "org.example.Test", "Test")};
+    msg.addArguments(fdStruct, fdDict, blobDict, fdArray);
+
+    DBusMessageIter iter;
+    dbus_message_iter_init(msg.get(), &iter);
+    auto [structOut, dictOut, blobsOut, arrayOut] =
+        parsers::parseArguments<FdStruct, FdDict, BlobDict, type::Array<FdStruct>>(&iter);
+    CHECK(std::get<0>(structOut) && std::get<1>(structOut) == 7);
+    CHECK(dictOut.at("stdin"));
+    CHECK(blobsOut.at("hello").size() == 5 && std::memcmp(blobsOut.at("hello").data(), "hello", 5) == 0);
+    CHECK(arrayOut.size() == 1 && std::get<0>(arrayOut[0]) && std::get<1>(arrayOut[0]) == 3);
+    return 0;
+}
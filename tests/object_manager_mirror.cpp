@@ -0,0 +1,118 @@
+#include "wibens/dbuspp/dbuspp.hpp"
+#include "wibens/dbuspp/eventloop.hpp"
+#include "wibens/dbuspp/server.hpp"
+#include "test.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace wibens::dbuspp;
+
+namespace {
+constexpr const char *SERVICE = "org.example.MirrorTest";
+constexpr const char *ROOT = "/org/example/MirrorTest";
+constexpr const char *OBJECT_MANAGER = "org.freedesktop.DBus.ObjectManager";
+constexpr const char *INTERFACE = "org.example.Device";
+constexpr int OBJECTS = 8;
+constexpr int MIRRORS = 128;
+// Keeps signals arriving around every snapshot without flooding the bus.
+constexpr std::chrono::microseconds EMIT_INTERVAL{20};
+using Interfaces = type::Dict<type::String, type::Dict<type::String, type::Variant<type::I32>>>;
+
+// Signals from one sender arrive in order, so a mirror that saw the marker has seen everything before it.
+int verify(const std::vector<std::unique_ptr<ObjectManagerMirror>> &mirrors, const type::ObjectPath &marker,
+           const std::vector<std::string> &expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    for (const auto &mirror : mirrors) {
+        while (!mirror->contains(marker) && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        CHECK(mirror->contains(marker));
+        CHECK(mirror->objects() == expected);
+        CHECK(mirror->objectsImplementing(INTERFACE) == expected);
+    }
+    return 0;
+}
+} // namespace
+
+// Mirrors built while another thread dispatches the client connection and the service keeps adding and removing
+// objects must all end up matching the service.
+int main() noexcept(false) {
+    std::unique_ptr<test::Daemon> daemon;
+    try {
+        daemon = std::make_unique<test::Daemon>();
+    } catch (const std::exception &e) {
+        std::printf("%s, skipping\n", e.what());
+        return test::SKIPPED;
+    }
+
+    auto service = DBus::openPrivate(DBUS_BUS_SESSION);
+    CHECK(service.requestName(SERVICE));
+    std::mutex mutex;
+    std::map<type::ObjectPath, Interfaces> objects;
+    ObjectServer server{service};
+    server.add(ROOT, {ObjectServer::Interface{OBJECT_MANAGER}.method("GetManagedObjects", [&] {
+        std::lock_guard lock(mutex);
+        return objects;
+    })});
+    EventLoop serviceLoop;
+    serviceLoop.attach(service);
+    std::thread serviceThread([&] { serviceLoop.run(); });
+
+    auto toggle = [&](const type::ObjectPath &objectPath, bool add) {
+        std::lock_guard lock(mutex);
+        if (add) {
+            Interfaces interfaces{{INTERFACE, {{"Index", 0}}}};
+            objects.insert_or_assign(objectPath, interfaces);
+            server.emit(ROOT, OBJECT_MANAGER, "InterfacesAdded", objectPath, interfaces);
+        } else {
+            objects.erase(objectPath);
+            server.emit(ROOT, OBJECT_MANAGER, "InterfacesRemoved", objectPath, type::Array<type::String>{INTERFACE});
+        }
+    };
+    std::atomic<bool> emitting{true};
+    std::thread emitter([&] {
+        // Every path is added and removed once, so a delta lost around a snapshot is never repaired.
+        auto objectPath = [](int index) { return type::ObjectPath{(ROOT + ("/" + std::to_string(index))).c_str()}; };
+        for (int round = 0; emitting; ++round) {
+            toggle(objectPath(round), true);
+            if (round >= OBJECTS) {
+                toggle(objectPath(round - OBJECTS), false);
+            }
+            std::this_thread::sleep_for(EMIT_INTERVAL);
+        }
+    });
+
+    DBus client(DBUS_BUS_SESSION);
+    EventLoop clientLoop;
+    clientLoop.attach(client);
+    std::thread clientThread([&] { clientLoop.run(); });
+
+    std::vector<std::unique_ptr<ObjectManagerMirror>> mirrors;
+    for (int i = 0; i < MIRRORS; ++i) {
+        mirrors.push_back(std::make_unique<ObjectManagerMirror>(&client, SERVICE, ROOT));
+    }
+    emitting = false;
+    emitter.join();
+
+    type::ObjectPath marker{(std::string{ROOT} + "/done").c_str()};
+    toggle(marker, true);
+    std::vector<std::string> expected;
+    for (const auto &[objectPath, interfaces] : objects) {
+        expected.push_back(objectPath);
+    }
+    auto result = verify(mirrors, marker, expected);
+
+    mirrors.clear();
+    clientLoop.stop();
+    clientThread.join();
+    serviceLoop.stop();
+    serviceThread.join();
+    return result;
+}
@@ -0,0 +1,81 @@
+#include "wibens/dbuspp/eventloop.hpp"
+#include "wibens/dbuspp/peer.hpp"
+#include "wibens/dbuspp/server.hpp"
+#include "test.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace wibens::dbuspp;
+
+namespace {
+constexpr const char *PATH = "/org/example/Peer";
+constexpr const char *INTERFACE = "org.example.Peer";
+constexpr int CLIENTS = 4;
+constexpr std::chrono::milliseconds SLOW_CALL{200};
+
+template <typename CONDITION> bool waitFor(CONDITION condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!condition() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return condition();
+}
+} // namespace
+
+// Clients that disconnect are dropped without waiting for the next one to connect, and destroying the server waits for
+// a call that is still being handled before dropping the client it came from.
+int main() noexcept(false) {
+    EventLoop loop;
+    std::thread loopThread([&loop] { loop.run(); });
+
+    std::atomic<int> live{0};
+    std::atomic<bool> handling{false};
+    std::atomic<bool> droppedWhileHandling{false};
+    ObjectServer::Interface peerInterface{INTERFACE};
+    peerInterface.method("Ping", [] { return type::I32{1}; }).method("Slow", [&handling] {
+        handling = true;
+        std::this_thread::sleep_for(SLOW_CALL);
+        handling = false;
+    });
+    auto server = std::make_unique<PeerServer>(loop, "unix:tmpdir=/tmp", [&](PeerConnection &connection) {
+        ++live;
+        std::shared_ptr<ObjectServer> objects{new ObjectServer(connection), [&](ObjectServer *objectServer) {
+                                                  droppedWhileHandling = droppedWhileHandling || handling;
+                                                  delete objectServer;
+                                                  --live;
+                                              }};
+        objects->add(PATH, {peerInterface});
+        return objects;
+    });
+
+    {
+        std::vector<std::unique_ptr<PeerConnection>> peers;
+        for (int i = 0; i < CLIENTS; ++i) {
+            peers.push_back(std::make_unique<PeerConnection>(server->address()));
+            CHECK(peers.back()->call<type::I32>("", PATH, INTERFACE, "Ping") == 1);
+        }
+        CHECK(live == CLIENTS);
+    }
+    CHECK(waitFor([&] { return live == 0 && server->size() == 0; }));
+
+    PeerConnection peer{server->address()};
+    std::thread caller([&peer] {
+        try {
+            peer.call("", PATH, INTERFACE, "Slow");
+        } catch (const std::runtime_error &) {
+            // The server may go away before replying.
+        }
+    });
+    CHECK(waitFor([&] { return handling.load(); }));
+    server.reset();
+    CHECK(!droppedWhileHandling);
+    CHECK(live == 0);
+
+    caller.join();
+    loop.stop();
+    loopThread.join();
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "proxygen_collisions.hpp"
+#include <type_traits>
+
+using namespace wibens::dbuspp;
+using test::Collisions;
+
+// The generated header compiles, methods keep their names and colliding accessors are renamed.
+static_assert(std::is_same_v<decltype(&Collisions::setLevel), void (Collisions::*)(const type::I32 &) const>);
+static_assert(std::is_same_v<decltype(&Collisions::setLevelProperty), void (Collisions::*)(const type::I32 &) const>);
+static_assert(std::is_same_v<decltype(&Collisions::level), type::I32 (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::name), type::String (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::getName), type::String (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::stateAsync), void (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::getState), type::U32 (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::path), type::ObjectPath (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::dbus), type::String (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::getProperty), type::String (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::setGetProperty), void (Collisions::*)(const type::String &) const>);
+static_assert(std::is_same_v<decltype(&Collisions::getDelete), bool (Collisions::*)() const>);
+static_assert(std::is_same_v<decltype(&Collisions::subscribeChanged), void (Collisions::*)() const>);
+
+int main() noexcept(false) {
+    Collisions collisions{nullptr, "org.example.Collisions", "/org/example/Collisions"};
+    auto subscribe = [&collisions] { return collisions.subscribeChangedSignal([](const type::String &) {}); };
+    static_assert(std::is_same_v<decltype(subscribe()), DBus::Subscription>);
+    return 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+#define CHECK(expr)                                                                                                    \
+    do {                                                                                                               \
+        if (!(expr)) {                                                                                                 \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #expr);                             \
+            return 1;                                                                                                  \
+        }                                                                                                              \
+    } while (0)
+
+namespace test {
+
+// Reported to ctest through SKIP_RETURN_CODE when a test cannot run here.
+constexpr int SKIPPED = 77;
+
+// Private session bus for the lifetime of the object, published through DBUS_SESSION_BUS_ADDRESS.
+class Daemon {
+  public:
+    Daemon() {
+        const char *binary = std::getenv("DBUS_DAEMON");
+        std::string command = std::string{binary ? binary : "dbus-daemon"} +
+                              " --session --fork --print-address=1 --print-pid=1 2>/dev/null";
+        FILE *output = popen(command.c_str(), "r");
+        if (output == nullptr) {
+            throw std::runtime_error("Could not start " + command);
+        }
+        std::array<char, 512> address{};
+        std::array<char, 32> pidLine{};
+        bool started = fgets(address.data(), address.size(), output) && fgets(pidLine.data(), pidLine.size(), output);
+        pclose(output);
+        if (!started) {
+            throw std::runtime_error("Could not start " + command);
+        }
+        pid = std::atoi(pidLine.data());
+        std::string_view trimmed{address.data()};
+        setenv("DBUS_SESSION_BUS_ADDRESS", std::string{trimmed.substr(0, trimmed.find('\n'))}.c_str(), 1);
+    }
+    Daemon(const Daemon &) = delete;
+    Daemon &operator=(const Daemon &) = delete;
+    ~Daemon() {
+        if (pid > 0) {
+            kill(pid, SIGTERM);
+        }
+    }
+
+  private:
+    pid_t pid{0};
+};
+
+} // namespace test
@@ -0,0 +1,361 @@
+#!/usr/bin/env python3
+"""Generates typed dbuspp proxy classes from D-Bus introspection XML.
+
+Every interface becomes a class holding a PreparedCall per method, so calls
+only marshal their arguments. Interface and member names are compile time
+constants.
+
+Usage: dbuspp-proxygen.py [--namespace NS] input.xml output.hpp
+"""
+
+import argparse
+import keyword
+import re
+import sys
+import xml.etree.ElementTree as ElementTree
+
+DBUSPP = "wibens::dbuspp"
+TYPE = DBUSPP + "::type::"
+
+BASIC_TYPES = {
+    "y": TYPE + "U8",
+    "b": "bool",
+    "n": TYPE + "I16",
+    "q": TYPE + "U16",
+    "i": TYPE + "I32",
+    "u": TYPE + "U32",
+    "x": TYPE + "I64",
+    "t": TYPE + "U64",
+    "d": TYPE + "Double",
+    "s": TYPE + "String",
+    "o": TYPE + "ObjectPath",
+    "g": TYPE + "Signature",
+    "h": TYPE + "UnixFileDescriptor",
+    # Variants can hold anything, the generated header defines which values they can be read as.
+    "v": "Variant",
+}
+
+CPP_KEYWORDS = {
+    "alignas", "alignof", "and", "asm", "auto", "bool", "break", "case", "catch", "char", "class", "const",
+    "constexpr", "continue", "default", "delete", "do", "double", "else", "enum", "explicit", "export", "extern",
+    "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new",
+    "noexcept", "not", "nullptr", "operator", "or", "private", "protected", "public", "register", "return",
+    "short", "signed", "sizeof", "static", "struct", "switch", "template", "this", "throw", "true", "try",
+    "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "while", "xor",
+}
+
+
+# Locals of the generated methods, arguments with these names get a trailing underscore.
+LOCALS = {"reply", "iter", "msg", "value", "handler"}
+
+
+class SignatureError(Exception):
+    pass
+
+
+def cpp_type(signature):
+    """Maps a single complete D-Bus type to its dbuspp type."""
+    result, rest = parse_type(signature)
+    if rest:
+        raise SignatureError(f"Trailing characters in type {signature}")
+    return result
+
+
+def parse_type(signature):
+    if not signature:
+        raise SignatureError("Empty type")
+    code, rest = signature[0], signature[1:]
+    if code in BASIC_TYPES:
+        return BASIC_TYPES[code], rest
+    if code == "a":
+        if rest.startswith("{"):
+            key, rest = parse_type(rest[1:])
+            value, rest = parse_type(rest)
+            if not rest.startswith("}"):
+                raise SignatureError(f"Unterminated dict entry in {signature}")
+            return f"{TYPE}Dict<{key}, {value}>", rest[1:]
+        element, rest = parse_type(rest)
+        return f"{TYPE}Array<{element}>", rest
+    if code == "(":
+        fields = []
+        while not rest.startswith(")"):
+            field, rest = parse_type(rest)
+            fields.append(field)
+        return f"{TYPE}Struct<{', '.join(fields)}>", rest[1:]
+    raise SignatureError(f"Unsupported type {code} in {signature}")
+
+
+def camel(name, upper):
+    parts = [part for part in re.split(r"[^A-Za-z0-9]+", name) if part]
+    joined = "".join(part[0].upper() + part[1:] for part in parts)
+    if not upper and joined:
+        joined = joined[0].lower() + joined[1:]
+    return joined
+
+
+def identifier(name):
+    name = camel(name, upper=False) or "arg"
+    if name[0].isdigit():
+        name = "_" + name
+    if name in CPP_KEYWORDS or keyword.iskeyword(name):
+        name += "_"
+    return name
+
+
+def unique(taken, candidates, *suffixes):
+    """Returns the first candidate that is free, together with its name plus each suffix, and marks them as taken."""
+    def free(name):
+        return all(name + suffix not in taken for suffix in ("",) + suffixes)
+
+    name = next((candidate for candidate in candidates if free(candidate)), None)
+    index = 2
+    while name is None:
+        name = candidates[-1] + str(index) if free(candidates[-1] + str(index)) else None
+        index += 1
+    taken.update(name + suffix for suffix in ("",) + suffixes)
+    return name
+
+
+def class_name(interface):
+    """org.freedesktop.NetworkManager.Device becomes NetworkManagerDevice, the reverse domain is dropped."""
+    parts = interface.split(".")
+    return camel("_".join(parts[2:] if len(parts) > 2 else parts), upper=True)
+
+
+def cpp_string(value):
+    return '"' + value.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+class Argument:
+    def __init__(self, element, index):
+        self.type = cpp_type(element.get("type"))
+        self.name = identifier(element.get("name") or f"arg{index}")
+        if self.name in LOCALS:
+            self.name += "_"
+        self.direction = element.get("direction", "in")
+
+
+class Member:
+    def __init__(self, element, default_direction):
+        self.name = element.get("name")
+        self.args = [Argument(arg, i) for i, arg in enumerate(element.findall("arg"))]
+        for arg in self.args:
+            if element.tag == "signal" or arg.direction not in ("in", "out"):
+                arg.direction = default_direction
+        self.inputs = [arg for arg in self.args if arg.direction == "in"]
+        self.outputs = [arg for arg in self.args if arg.direction == "out"]
+
+
+class Property:
+    def __init__(self, element):
+        self.name = element.get("name")
+        self.type = cpp_type(element.get("type"))
+        self.access = element.get("access", "read")
+
+
+class Generator:
+    def __init__(self):
+        self.lines = []
+
+    def emit(self, line=""):
+        self.lines.append(line)
+
+    def interface(self, element):
+        name = element.get("name")
+        cls = class_name(name)
+        methods = [Member(method, "in") for method in element.findall("method")]
+        signals = [Member(signal, "out") for signal in element.findall("signal")]
+        properties = [Property(prop) for prop in element.findall("property")]
+
+        readable = [prop for prop in properties if "read" in prop.access]
+        writable = [prop for prop in properties if "write" in prop.access]
+
+        # Methods keep their names, generated accessors that would collide with them or each other are renamed.
+        taken = set()
+        for method in methods:
+            taken.update({identifier(method.name), identifier(method.name) + "Async"})
+        getters = {}
+        for prop in readable:
+            getter = identifier(prop.name)
+            prefixed = "get" + camel(prop.name, upper=True)
+            candidates = ([] if getter.endswith("_") else [getter]) + [prefixed, prefixed + "Property"]
+            getters[prop.name] = unique(taken, candidates, "Async")
+        setters = {}
+        for prop in writable:
+            setter = "set" + camel(prop.name, upper=True)
+            setters[prop.name] = unique(taken, [setter, setter + "Property"])
+        subscribers = {}
+        for signal in signals:
+            subscriber = "subscribe" + camel(signal.name, upper=True)
+            subscribers[signal.name] = unique(taken, [subscriber, subscriber + "Signal"])
+
+        self.emit(f"// {name}")
+        self.emit(f"class {cls} {{")
+        self.emit("  public:")
+        self.emit(f"    static constexpr const char *INTERFACE = {cpp_string(name)};")
+        self.emit()
+        self.constructor(cls, methods, bool(readable), bool(writable))
+
+        for method in methods:
+            self.method(method)
+        for prop in readable:
+            self.getter(prop, getters[prop.name])
+        for prop in writable:
+            self.setter(prop, setters[prop.name])
+        for signal in signals:
+            self.signal(signal, subscribers[signal.name])
+
+        self.emit()
+        self.emit("  private:")
+        self.emit('    static constexpr const char *PROPERTIES = "org.freedesktop.DBus.Properties";')
+        self.emit()
+        for method in methods:
+            self.call_type(method)
+        if methods:
+            self.emit()
+        # Members end in an underscore, generated names only do that for C++ keywords.
+        self.emit(f"    {DBUSPP}::DBus *dbus_;")
+        self.emit("    std::string destination_;")
+        self.emit("    std::string path_;")
+        if readable:
+            self.emit(f"    {DBUSPP}::PreparedCall<void(const char *, const char *)> getProperty_;")
+        if writable:
+            self.emit(f"    {DBUSPP}::PreparedCall<void(const char *, const char *)> setProperty_;")
+        for method in methods:
+            self.emit(f"    {camel(method.name, upper=True)}Call {identifier(method.name)}Call_;")
+        self.emit("};")
+        self.emit()
+
+    def constructor(self, cls, methods, readable, writable):
+        inits = ["dbus_(dbus)", "destination_(std::move(destination))", "path_(std::move(path))"]
+        if readable:
+            inits.append('getProperty_(dbus, destination_, path_, PROPERTIES, "Get")')
+        if writable:
+            inits.append('setProperty_(dbus, destination_, path_, PROPERTIES, "Set")')
+        for method in methods:
+            inits.append(f"{identifier(method.name)}Call_(dbus, destination_, path_, INTERFACE, "
+                         f"{cpp_string(method.name)})")
+        self.emit(f"    {cls}({DBUSPP}::DBus *dbus, std::string destination, std::string path)")
+        for index, init in enumerate(inits):
+            prefix = ": " if index == 0 else "  "
+            suffix = " {}" if index == len(inits) - 1 else ","
+            self.emit(f"        {prefix}{init}{suffix}")
+
+    @staticmethod
+    def return_type(member):
+        if not member.outputs:
+            return "void"
+        if len(member.outputs) == 1:
+            return member.outputs[0].type
+        return f"std::tuple<{', '.join(arg.type for arg in member.outputs)}>"
+
+    def call_type(self, method):
+        ret = self.return_type(method) if len(method.outputs) < 2 else "void"
+        inputs = ", ".join(arg.type for arg in method.inputs)
+        call = f"{camel(method.name, upper=True)}Call"
+        self.emit(f"    using {call} = {DBUSPP}::PreparedCall<{ret}({inputs})>;")
+
+    def method(self, method):
+        name = identifier(method.name)
+        ret = self.return_type(method)
+        params = ", ".join(f"const {arg.type} &{arg.name}" for arg in method.inputs)
+        args = ", ".join(arg.name for arg in method.inputs)
+        self.emit()
+        self.emit(f"    {ret} {name}({params}) const {{")
+        if len(method.outputs) < 2:
+            self.emit(f"        return {name}Call_({args});")
+        else:
+            # A tuple would be read as a struct, multiple out arguments are read one by one.
+            out_types = ", ".join(arg.type for arg in method.outputs)
+            self.emit(f"        auto reply = dbus_->sendMessage({name}Call_.makeMessage({args}));")
+            self.emit("        DBusMessageIter iter;")
+            self.emit("        dbus_message_iter_init(reply.get(), &iter);")
+            self.emit(f"        return {DBUSPP}::parsers::parseArguments<{out_types}>(&iter);")
+        self.emit("    }")
+        if len(method.outputs) < 2:
+            self.emit(f"    {DBUSPP}::DBus::PendingCall<{ret}> {name}Async({params}) const {{")
+            self.emit(f"        return {name}Call_.async({args});")
+            self.emit("    }")
+        else:
+            # PendingCall<std::tuple<...>> would parse a struct, the out arguments are read one by one above.
+            self.emit(f"    // No {name}Async(), PendingCall can not return several out arguments.")
+
+    def getter(self, prop, name):
+        value = f"{TYPE}Variant<{prop.type}>"
+        message = f"getProperty_.makeMessage(INTERFACE, {cpp_string(prop.name)})"
+        self.emit()
+        self.emit(f"    {prop.type} {name}() const {{")
+        self.emit(f"        return std::get<0>(dbus_->sendMessage({message}).response<{value}>());")
+        self.emit("    }")
+        self.emit(f"    {DBUSPP}::DBus::PendingCall<{value}> {name}Async() const {{")
+        self.emit(f"        return dbus_->sendMessageAsync<{value}>({message});")
+        self.emit("    }")
+
+    def setter(self, prop, name):
+        self.emit()
+        self.emit(f"    void {name}(const {prop.type} &value) const {{")
+        self.emit(f"        auto msg = setProperty_.makeMessage(INTERFACE, {cpp_string(prop.name)});")
+        self.emit(f"        msg.addArgument({TYPE}Variant<{prop.type}>{{value}});")
+        self.emit("        dbus_->sendMessage(msg);")
+        self.emit("    }")
+
+    def signal(self, signal, subscribe):
+        types = ", ".join(arg.type for arg in signal.args)
+        names = ", ".join(arg.name for arg in signal.args) or "no arguments"
+        self.emit()
+        self.emit(f"    // Calls handler({names}) for every {signal.name} signal of this object.")
+        self.emit("    template <typename HANDLER>")
+        self.emit(f"    {DBUSPP}::DBus::Subscription {subscribe}(HANDLER &&handler) const {{")
+        member = cpp_string(signal.name)
+        self.emit(f"        return dbus_->subscribe<{types}>(destination_, path_, INTERFACE, {member},")
+        self.emit("                                      std::forward<HANDLER>(handler));")
+        self.emit("    }")
+
+
+def generate(root, namespace, source):
+    generator = Generator()
+    emit = generator.emit
+    emit(f"// Generated by dbuspp-proxygen.py from {source}, do not edit.")
+    emit("#pragma once")
+    emit()
+    emit('#include "wibens/dbuspp/dbuspp.hpp"')
+    emit("#include <string>")
+    emit("#include <tuple>")
+    emit("#include <utility>")
+    emit()
+    if namespace:
+        emit(f"namespace {namespace} {{")
+        emit()
+    emit("// Values of D-Bus variants ('v') can be read as any of these types.")
+    emit(f"using Variant = {TYPE}Variant<bool, {TYPE}U8, {TYPE}I16, {TYPE}U16, {TYPE}I32, {TYPE}U32, {TYPE}I64,")
+    emit(f"                                {TYPE}U64, {TYPE}Double, {TYPE}String, {TYPE}ObjectPath,")
+    emit(f"                                {TYPE}Signature, {TYPE}Array<{TYPE}String>,")
+    emit(f"                                {TYPE}Array<{TYPE}ObjectPath>, {TYPE}Array<{TYPE}U8>>;")
+    emit()
+    interfaces = root.findall("interface") if root.tag == "node" else [root]
+    for interface in interfaces:
+        generator.interface(interface)
+    if namespace:
+        emit(f"}} // namespace {namespace}")
+    return "\n".join(generator.lines).rstrip("\n") + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--namespace", default="", help="namespace of the generated classes, e.g. nm::proxy")
+    parser.add_argument("input", help="introspection XML")
+    parser.add_argument("output", help="header to write")
+    options = parser.parse_args()
+
+    try:
+        header = generate(ElementTree.parse(options.input).getroot(), options.namespace, options.input.split("/")[-1])
+    except (ElementTree.ParseError, SignatureError) as error:
+        print(f"{options.input}: {error}", file=sys.stderr)
+        return 1
+    with open(options.output, "w", encoding="utf-8") as output:
+        output.write(header)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())